@@ -0,0 +1,56 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<std::uint64_t> allocations{0};
+
+}
+
+std::uint64_t allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void * operator new(const std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void * const pointer = std::malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void * operator new[](const std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * const pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void * const pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void * const pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void * const pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
@@ -0,0 +1,9 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <cstdint>
+
+// Number of calls to the global operator new so far. Linking allocation_counter.cpp replaces the
+// global allocation functions of the whole executable.
+std::uint64_t allocation_count();
@@ -0,0 +1,330 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Drives Listener on a Reactor over loopback UDP, with a mock layout backend, and reports for each
+// receive backend and burst size: sustained packets per second, CPU time, heap allocations and
+// syscalls per packet on the reactor thread, and receive-to-callback latency. Syscalls count the
+// reactor's wakeups (one epoll_wait() each) plus the listener's receive syscalls. Results are
+// written as JSON lines.
+//
+//   listener-bench [packets] [burst sizes, comma-separated] [output file] [backends: socket,io_uring]
+
+#include "allocation_counter.h"
+#include "endpoint.h"
+#include "layout_applier.h"
+#include "layout_backend.h"
+#include "listener.h"
+#include "probe.h"
+#include "protocol.h"
+#include "reactor.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Bursts the sender may be ahead of the listener; keeps the socket buffer from overflowing, so
+// that the result is the sustained rate rather than the drop rate.
+constexpr std::size_t bursts_in_flight = 2;
+constexpr std::array<const char *, 4> layouts = {"us", "ru", "de", "fr"};
+
+class MockBackend : public LayoutBackend
+{
+public:
+    std::string get_layout() const override
+    {
+        return {};
+    }
+
+    void set_layout(const std::string &) const override
+    {
+    }
+};
+
+// Counts the allocations the listener makes on the reactor thread as well.
+class AllocationProbe : public Probe
+{
+public:
+    using Probe::Probe;
+
+    void on_readable(const int ready_fd) override
+    {
+        const std::uint64_t allocations_begin = allocation_count();
+        Probe::on_readable(ready_fd);
+        allocations += allocation_count() - allocations_begin;
+    }
+
+    std::uint64_t allocations = 0;
+};
+
+struct Result
+{
+    ReceiveBackend backend;
+    std::size_t burst_size;
+    std::uint64_t packets_sent;
+    std::uint64_t packets_received;
+    double seconds;
+    double cpu_ns_per_packet;
+    double allocations_per_packet;
+    double syscalls_per_packet;
+    double p50_latency_us;
+    double p99_latency_us;
+    double max_latency_us;
+};
+
+Result run(const std::uint64_t packet_count, const std::size_t burst_size, const ReceiveBackend backend)
+{
+    std::vector<Clock::time_point> sent_at(packet_count + 1);
+    std::vector<double> latencies_us;
+    latencies_us.reserve(packet_count);
+    std::atomic<std::uint64_t> callbacks{0};
+
+    auto applier = std::make_shared<LayoutApplier>(std::make_shared<MockBackend>());
+    Listener listener(
+        "127.0.0.1",
+        "0",
+        TransportOptions{},
+        [&](const protocol::Message & message)
+        {
+            latencies_us.push_back(
+                std::chrono::duration<double, std::micro>(Clock::now() - sent_at[message.sequence]).count());
+            applier->apply(message.layout);
+            callbacks.fetch_add(1, std::memory_order_release);
+        },
+        nullptr,
+        backend);
+
+    // Every packet ends up either in the callback or in one of the listener's drop counters.
+    const auto received = [&]
+    {
+        return callbacks.load(std::memory_order_acquire)
+            + listener.coalesced_packets()
+            + listener.stale_packets();
+    };
+
+    AllocationProbe probe(listener);
+    Reactor reactor;
+    reactor.start();
+
+    if (!reactor.add(probe))
+    {
+        std::cerr << "cannot open the listener" << std::endl;
+        std::exit(1);
+    }
+
+    const std::vector<ListenerSocketStats> sockets = listener.socket_stats();
+
+    if (sockets.front().backend != backend)
+    {
+        std::cerr << "receive backend not available" << std::endl;
+        std::exit(1);
+    }
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(std::atoi(parse_endpoint(sockets.front().address)->port.c_str()));
+    const int send_fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+    std::vector<std::array<char, protocol::max_packet_size>> packets(burst_size);
+    std::vector<struct iovec> iovecs(burst_size);
+    std::vector<struct mmsghdr> headers(burst_size);
+
+    const auto begin = Clock::now();
+    std::uint64_t sent = 0;
+
+    while (sent < packet_count)
+    {
+        while (sent - received() > bursts_in_flight * burst_size)
+        {
+            std::this_thread::yield();
+        }
+
+        const std::size_t count = std::min<std::uint64_t>(burst_size, packet_count - sent);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            protocol::Message message;
+            message.origin = 1;
+            message.sequence = static_cast<std::uint32_t>(sent + i + 1);
+            message.layout = layouts[(sent + i) % layouts.size()];
+
+            const std::size_t size = protocol::encode(message, packets[i].data(), packets[i].size());
+            iovecs[i] = {packets[i].data(), size};
+            headers[i] = {};
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &address;
+            headers[i].msg_hdr.msg_namelen = sizeof(address);
+        }
+
+        const auto now = Clock::now();
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sent_at[sent + i + 1] = now;
+        }
+
+        const int batch_sent = ::sendmmsg(send_fd, headers.data(), count, 0);
+
+        if (batch_sent <= 0)
+        {
+            std::cerr << "sendmmsg() failed" << std::endl;
+            std::exit(1);
+        }
+
+        sent += batch_sent;
+    }
+
+    // Packets the socket buffer dropped never arrive, so the tail is waited for only until the
+    // listener stops making progress.
+    std::uint64_t last_received = received();
+    auto end = Clock::now();
+
+    while (last_received < sent && Clock::now() - end < std::chrono::milliseconds(200))
+    {
+        std::this_thread::yield();
+
+        if (const std::uint64_t now_received = received(); now_received != last_received)
+        {
+            last_received = now_received;
+            end = Clock::now();
+        }
+    }
+
+    const std::uint64_t packets_received = received();
+    const std::uint64_t receive_syscalls = listener.socket_stats().front().receive_syscalls;
+
+    reactor.stop();
+    ::close(send_fd);
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+
+    Result result = {};
+    result.backend = backend;
+    result.burst_size = burst_size;
+    result.packets_sent = sent;
+    result.packets_received = packets_received;
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.cpu_ns_per_packet = static_cast<double>(probe.cpu_ns) / std::max<std::uint64_t>(1, packets_received);
+    result.allocations_per_packet =
+        static_cast<double>(probe.allocations) / std::max<std::uint64_t>(1, packets_received);
+    result.syscalls_per_packet =
+        static_cast<double>(probe.wakeups + receive_syscalls) / std::max<std::uint64_t>(1, packets_received);
+
+    if (!latencies_us.empty())
+    {
+        result.p50_latency_us = latencies_us[latencies_us.size() / 2];
+        result.p99_latency_us = latencies_us[latencies_us.size() * 99 / 100];
+        result.max_latency_us = latencies_us.back();
+    }
+
+    return result;
+}
+
+std::string to_json(const Result & result)
+{
+    std::ostringstream stream;
+    stream << "{\"backend\": \"" << (result.backend == ReceiveBackend::IoUring ? "io_uring" : "socket")
+        << "\", \"burst_size\": " << result.burst_size
+        << ", \"packets_sent\": " << result.packets_sent
+        << ", \"packets_received\": " << result.packets_received
+        << ", \"packets_per_second\": " << result.packets_received / result.seconds
+        << ", \"cpu_ns_per_packet\": " << result.cpu_ns_per_packet
+        << ", \"allocations_per_packet\": " << result.allocations_per_packet
+        << ", \"syscalls_per_packet\": " << result.syscalls_per_packet
+        << ", \"p50_latency_us\": " << result.p50_latency_us
+        << ", \"p99_latency_us\": " << result.p99_latency_us
+        << ", \"max_latency_us\": " << result.max_latency_us
+        << "}";
+    return stream.str();
+}
+
+std::vector<std::size_t> parse_burst_sizes(const std::string & list)
+{
+    std::vector<std::size_t> burst_sizes;
+    std::istringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        if (const long size = std::atol(item.c_str()); size > 0)
+        {
+            burst_sizes.push_back(size);
+        }
+    }
+
+    return burst_sizes;
+}
+
+std::vector<ReceiveBackend> parse_backends(const std::string & list)
+{
+    std::vector<ReceiveBackend> backends;
+    std::istringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        if (item == "socket")
+        {
+            backends.push_back(ReceiveBackend::Socket);
+        }
+        else if (item == "io_uring")
+        {
+            backends.push_back(ReceiveBackend::IoUring);
+        }
+    }
+
+    return backends;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const std::uint64_t packets = argc > 1 ? std::atoll(argv[1]) : 200000;
+    const std::vector<std::size_t> burst_sizes = parse_burst_sizes(argc > 2 ? argv[2] : "1,8,64");
+    const std::vector<ReceiveBackend> backends = parse_backends(argc > 4 ? argv[4] : "socket,io_uring");
+
+    std::ofstream file;
+
+    if (argc > 3)
+    {
+        file.open(argv[3]);
+
+        if (!file)
+        {
+            std::cerr << "cannot open " << argv[3] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostream & output = file.is_open() ? file : std::cout;
+
+    for (const ReceiveBackend backend : backends)
+    {
+        for (const std::size_t burst_size : burst_sizes)
+        {
+            output << to_json(run(packets, burst_size, backend)) << std::endl;
+        }
+    }
+
+    return 0;
+}
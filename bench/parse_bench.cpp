@@ -0,0 +1,88 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Compares the per-packet cost of protocol::parse() against the regex-based parsing that
+// Listener used for plain-text packets.
+
+#include "protocol.h"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <regex>
+#include <string>
+
+namespace
+{
+
+constexpr std::size_t buffer_size = 1024;
+
+template <typename F>
+double measure_ns(const int iterations, F && parse_packet)
+{
+    std::size_t checksum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        checksum += parse_packet();
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+
+    if (checksum == 0)
+    {
+        std::cerr << "unexpected parse failure" << std::endl;
+        std::exit(1);
+    }
+
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::array<char, buffer_size> text_buffer{};
+    const std::string text = "us";
+    std::memcpy(text_buffer.data(), text.data(), text.size());
+
+    std::array<char, buffer_size> binary_buffer{};
+    protocol::Message message;
+    message.origin = 1;
+    message.sequence = 42;
+    message.timestamp_us = protocol::now_us();
+    message.layout = "us";
+    const std::size_t binary_size =
+        protocol::encode(message, binary_buffer.data(), binary_buffer.size());
+
+    const double regex_ns = measure_ns(iterations, [&]
+    {
+        static std::regex word{R"(\w+)"};
+        std::string data_str(text_buffer.data(), text_buffer.size());
+        std::smatch result;
+        return std::regex_search(data_str, result, word) ? result.length(0) : 0;
+    });
+
+    const double legacy_ns = measure_ns(iterations, [&]
+    {
+        const auto parsed = protocol::parse(text_buffer.data(), text.size());
+        return parsed ? parsed->layout.size() : 0;
+    });
+
+    const double binary_ns = measure_ns(iterations, [&]
+    {
+        const auto parsed = protocol::parse(binary_buffer.data(), binary_size);
+        return parsed ? parsed->layout.size() : 0;
+    });
+
+    std::cout << "iterations: " << iterations << "\n"
+        << "regex_ns_per_packet: " << regex_ns << "\n"
+        << "legacy_ns_per_packet: " << legacy_ns << "\n"
+        << "binary_ns_per_packet: " << binary_ns << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Measures event-to-wire latency of the transmitter, comparing sending inline on the capturing
+// thread with handing changes to TransmitStage through its lock-free queue. A UDP sink on
+// loopback timestamps every packet on arrival.
+
+#include "protocol.h"
+#include "routing.h"
+#include "transmit_stage.h"
+#include "transmitter.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct Result
+{
+    std::vector<double> wire_latencies_us;
+    std::vector<double> capture_costs_us;
+};
+
+class Sink
+{
+public:
+    Sink()
+        : fd_{::socket(AF_INET, SOCK_DGRAM, 0)}
+    {
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t address_size = sizeof(address);
+
+        struct timeval timeout = {1, 0};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (::bind(fd_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+            || ::getsockname(fd_, reinterpret_cast<struct sockaddr *>(&address), &address_size) != 0)
+        {
+            std::cerr << "cannot bind the sink" << std::endl;
+            std::exit(1);
+        }
+
+        port_ = std::to_string(ntohs(address.sin_port));
+    }
+
+    ~Sink()
+    {
+        ::close(fd_);
+    }
+
+    const std::string & port() const
+    {
+        return port_;
+    }
+
+    // Receives until expected layout updates arrived or the socket times out.
+    std::vector<double> receive(const std::size_t expected)
+    {
+        std::vector<double> latencies_us;
+        latencies_us.reserve(expected);
+        std::array<char, protocol::max_packet_size> buffer;
+
+        while (latencies_us.size() < expected)
+        {
+            const auto size = ::recv(fd_, buffer.data(), buffer.size(), 0);
+
+            if (size < 0)
+            {
+                break;
+            }
+
+            const std::uint64_t now = protocol::now_us();
+
+            // Heartbeats carry the capture time of an older change and are not events.
+            if (const auto message = protocol::parse(buffer.data(), size);
+                message && (message->flags & protocol::flag_heartbeat) == 0)
+            {
+                latencies_us.push_back(static_cast<double>(now - message->timestamp_us));
+            }
+        }
+
+        return latencies_us;
+    }
+
+private:
+    const int fd_;
+    std::string port_;
+};
+
+// setup gets the sink's port and builds the pipeline before timing starts; send is timed.
+template <typename Setup, typename Send>
+Result run(const int events, const std::chrono::microseconds interval, Setup && setup, Send && send)
+{
+    Sink sink;
+    setup(sink.port());
+
+    Result result;
+    result.capture_costs_us.reserve(events);
+
+    std::thread receiver([&] { result.wire_latencies_us = sink.receive(events); });
+
+    for (int i = 0; i < events; ++i)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        send(GroupChange{i % 2, protocol::now_us()});
+        const auto end = std::chrono::steady_clock::now();
+
+        result.capture_costs_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+        std::this_thread::sleep_for(interval);
+    }
+
+    receiver.join();
+    return result;
+}
+
+void report(const std::string & name, std::vector<double> values)
+{
+    if (values.empty())
+    {
+        std::cout << name << "_count: 0\n";
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+    std::cout << name << "_count: " << values.size() << "\n"
+        << name << "_p50_us: " << values[values.size() / 2] << "\n"
+        << name << "_p99_us: " << values[values.size() * 99 / 100] << "\n"
+        << name << "_max_us: " << values.back() << "\n";
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const int events = argc > 1 ? std::atoi(argv[1]) : 2000;
+    const std::chrono::microseconds interval{argc > 2 ? std::atoi(argv[2]) : 200};
+    const std::map<std::string, std::string> keyboard_groups = {{"0", "us"}, {"1", "ru"}};
+    const GroupRoutes routes{keyboard_groups};
+
+    {
+        std::unique_ptr<Transmitter> transmitter;
+        TransmitterStats stats;
+
+        const Result inline_result = run(
+            events,
+            interval,
+            [&](const std::string & port)
+            {
+                transmitter = std::make_unique<Transmitter>(TransportOptions{}, false, stats);
+                transmitter->set_destinations({Resolver::lookup_endpoint({"127.0.0.1", port})});
+            },
+            [&](const GroupChange & change)
+            {
+                transmitter->send(*routes.find(change.group), change.timestamp_us);
+            });
+
+        report("inline_wire", inline_result.wire_latencies_us);
+        report("inline_capture", inline_result.capture_costs_us);
+    }
+
+    {
+        std::unique_ptr<TransmitStage> stage;
+
+        const Result staged_result = run(
+            events,
+            interval,
+            [&](const std::string & port)
+            {
+                stage = std::make_unique<TransmitStage>(
+                    std::vector<Endpoint>{{"127.0.0.1", port}},
+                    TransportOptions{},
+                    false,
+                    false,
+                    keyboard_groups);
+                stage->start();
+                // Let the background resolver deliver the address before timing starts.
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            },
+            [&](const GroupChange & change)
+            {
+                stage->post(change);
+            });
+
+        stage->stop();
+        report("staged_wire", staged_result.wire_latencies_us);
+        report("staged_capture", staged_result.capture_costs_us);
+    }
+
+    std::cout.flush();
+    return 0;
+}
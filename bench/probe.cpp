@@ -0,0 +1,50 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "probe.h"
+
+#include <ctime>
+
+std::uint64_t thread_cpu_ns()
+{
+    struct timespec time = {};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<std::uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+Probe::Probe(EventHandler & handler)
+    : handler_{handler}
+{
+}
+
+std::vector<int> Probe::open()
+{
+    return handler_.open();
+}
+
+void Probe::close()
+{
+    handler_.close();
+}
+
+void Probe::on_readable(const int fd)
+{
+    const std::uint64_t begin = thread_cpu_ns();
+    handler_.on_readable(fd);
+    cpu_ns += thread_cpu_ns() - begin;
+    ++wakeups;
+}
+
+int Probe::prepare()
+{
+    const std::uint64_t begin = thread_cpu_ns();
+    const int timeout_ms = handler_.prepare();
+    cpu_ns += thread_cpu_ns() - begin;
+    return timeout_ms;
+}
+
+void Probe::on_timeout()
+{
+    const std::uint64_t begin = thread_cpu_ns();
+    handler_.on_timeout();
+    cpu_ns += thread_cpu_ns() - begin;
+}
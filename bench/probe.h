@@ -0,0 +1,33 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "reactor.h"
+
+#include <cstdint>
+#include <vector>
+
+// CPU time consumed by the calling thread so far.
+std::uint64_t thread_cpu_ns();
+
+// Forwards every callback to a handler on a Reactor, measuring the reactor thread's CPU time spent
+// in on_readable(), prepare() and on_timeout(). Only read the counters once the reactor has stopped
+// or the handler has been removed.
+class Probe : public EventHandler
+{
+public:
+    explicit Probe(EventHandler & handler);
+
+    std::vector<int> open() override;
+    void close() override;
+    void on_readable(int fd) override;
+    int prepare() override;
+    void on_timeout() override;
+
+    // Calls of on_readable().
+    std::uint64_t wakeups = 0;
+    std::uint64_t cpu_ns = 0;
+
+private:
+    EventHandler & handler_;
+};
@@ -0,0 +1,173 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Counts heap allocations and time per update on the hot paths: mapping a group to a packet
+// (string-keyed map versus GroupRoutes), sending it with Transmitter, and applying a received
+// packet through LayoutApplier. Exits with status 1 if any GroupRoutes-based path allocates.
+
+#include "allocation_counter.h"
+#include "layout_applier.h"
+#include "layout_backend.h"
+#include "protocol.h"
+#include "routing.h"
+#include "transmitter.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct Measurement
+{
+    double allocations_per_op;
+    double ns_per_op;
+};
+
+class NullBackend : public LayoutBackend
+{
+public:
+    std::string get_layout() const override
+    {
+        return {};
+    }
+
+    void set_layout(const std::string & layout) const override
+    {
+        checksum_ += layout.size();
+    }
+
+    mutable std::size_t checksum_ = 0;
+};
+
+template <typename F>
+Measurement measure(const int iterations, F && operation)
+{
+    // Warm up lazily allocated state outside of the measurement.
+    operation(0);
+
+    const std::uint64_t allocations_before = allocation_count();
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        operation(i);
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const std::uint64_t allocations_after = allocation_count();
+
+    return {
+        static_cast<double>(allocations_after - allocations_before) / iterations,
+        std::chrono::duration<double, std::nano>(end - begin).count() / iterations};
+}
+
+void report(const std::string & name, const Measurement & measurement)
+{
+    std::cout << name << "_allocations_per_op: " << measurement.allocations_per_op << "\n"
+        << name << "_ns_per_op: " << measurement.ns_per_op << "\n";
+}
+
+ResolvedEndpoints loopback_sink(const int fd)
+{
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+        || ::getsockname(fd, reinterpret_cast<struct sockaddr *>(&address), &size) != 0)
+    {
+        std::cerr << "cannot bind the sink" << std::endl;
+        std::exit(1);
+    }
+
+    struct sockaddr_storage storage = {};
+    std::memcpy(&storage, &address, sizeof(address));
+    return {{storage}};
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const std::map<std::string, std::string> keyboard_groups = {
+        {"0", "us"},
+        {"1", "ru"},
+        {"2", "de(deadgraveacute)"},
+        {"3", "fr(bepo_afnor)"}};
+    const GroupRoutes routes{keyboard_groups};
+    std::array<char, protocol::max_packet_size> packet;
+
+    const Measurement map_lookup = measure(iterations, [&](const int i)
+    {
+        const auto group_it = keyboard_groups.find(std::to_string(i % 4));
+        protocol::Message message;
+        message.sequence = i;
+        message.layout = group_it->second;
+        protocol::encode(message, packet.data(), packet.size());
+    });
+
+    const Measurement routes_lookup = measure(iterations, [&](const int i)
+    {
+        const EncodedLayout * const layout = routes.find(i % 4);
+        std::copy_n(layout->packet.cbegin(), layout->size, packet.begin());
+        protocol::stamp(packet.data(), 0, 0, i, 0);
+    });
+
+    const int sink_fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    TransmitterStats stats;
+    Transmitter transmitter(TransportOptions{}, false, stats);
+    transmitter.set_destinations(loopback_sink(sink_fd));
+
+    const Measurement transmit = measure(iterations, [&](const int i)
+    {
+        transmitter.send(*routes.find(i % 4), 0);
+    });
+
+    ::close(sink_fd);
+
+    std::array<std::array<char, protocol::max_packet_size>, 4> received;
+    std::array<std::size_t, 4> received_sizes;
+
+    for (std::size_t group = 0; group < received.size(); ++group)
+    {
+        const EncodedLayout & layout = *routes.find(group);
+        received[group] = layout.packet;
+        received_sizes[group] = layout.size;
+    }
+
+    const auto backend = std::make_shared<NullBackend>();
+    LayoutApplier applier(backend, LayoutTable{keyboard_groups});
+
+    // Repeats every layout once, so that half of the packets are skipped as already active.
+    const Measurement apply = measure(iterations, [&](const int i)
+    {
+        const std::size_t group = (i / 2) % 4;
+        applier.apply(protocol::parse(received[group].data(), received_sizes[group])->layout);
+    });
+
+    report("map_lookup", map_lookup);
+    report("routes_lookup", routes_lookup);
+    report("transmit", transmit);
+    report("apply", apply);
+    std::cout << "packets_sent: " << stats.packets_sent.load() << "\n"
+        << "layouts_applied: " << applier.applied_count() << "\n"
+        << "layouts_skipped: " << applier.skipped_count() << "\n";
+
+    return routes_lookup.allocations_per_op == 0
+        && transmit.allocations_per_op == 0
+        && apply.allocations_per_op == 0 ? 0 : 1;
+}
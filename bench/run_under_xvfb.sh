@@ -0,0 +1,38 @@
+#!/bin/sh
+# vi: ts=4 sw=4 tw=100 et
+#
+# Runs a command against a private Xvfb with a four-group keymap, e.g.
+#   run_under_xvfb.sh ./sender-bench 1000 200
+
+set -e
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 command [arguments...]" >&2
+    exit 2
+fi
+
+display_number=${XVFB_DISPLAY:-99}
+
+while [ -e "/tmp/.X${display_number}-lock" ]; do
+    display_number=$((display_number + 1))
+done
+
+Xvfb ":${display_number}" -nolisten tcp -screen 0 320x240x24 >/dev/null 2>&1 &
+xvfb_pid=$!
+trap 'kill "${xvfb_pid}" 2>/dev/null; wait "${xvfb_pid}" 2>/dev/null || true' EXIT INT TERM
+
+export DISPLAY=":${display_number}"
+
+tries=0
+until xdpyinfo >/dev/null 2>&1 || [ -e "/tmp/.X11-unix/X${display_number}" ]; do
+    tries=$((tries + 1))
+    if [ "${tries}" -gt 50 ]; then
+        echo "Xvfb did not start" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+setxkbmap -layout us,ru,de,fr
+
+"$@"
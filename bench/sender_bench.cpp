@@ -0,0 +1,291 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Drives Sender on a Reactor against a real X server, normally a private Xvfb started by
+// run_under_xvfb.sh. A second X connection locks keyboard groups with XkbLockGroup() at a fixed
+// rate and a UDP sink on loopback captures what the sender emits. Reports event-to-wire latency,
+// changes that never reached the wire or reached it twice, and CPU time per event. With a
+// coalescing window, dropped changes are expected; compare them with the suppressed updates.
+//
+//   sender-bench [events] [events per second] [coalescing window ms]
+//
+// The server needs a keymap with several groups, e.g. setxkbmap -layout us,ru,de,fr.
+
+#include "probe.h"
+#include "protocol.h"
+#include "reactor.h"
+#include "sender.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <X11/XKBlib.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+const std::map<std::string, std::string> keyboard_groups = {
+    {"0", "us"},
+    {"1", "ru"},
+    {"2", "de"},
+    {"3", "fr"}};
+
+struct Arrival
+{
+    std::string layout;
+    std::uint64_t received_us;
+};
+
+std::uint64_t process_cpu_ns()
+{
+    struct rusage usage = {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return (static_cast<std::uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+class Sink
+{
+public:
+    Sink()
+        : fd_{::socket(AF_INET, SOCK_DGRAM, 0)}
+    {
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t address_size = sizeof(address);
+
+        // Only bounds how long receive() takes to notice that it should stop.
+        struct timeval timeout = {0, 50000};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (::bind(fd_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+            || ::getsockname(fd_, reinterpret_cast<struct sockaddr *>(&address), &address_size) != 0)
+        {
+            std::cerr << "cannot bind the sink" << std::endl;
+            std::exit(1);
+        }
+
+        port_ = std::to_string(ntohs(address.sin_port));
+    }
+
+    ~Sink()
+    {
+        ::close(fd_);
+    }
+
+    const std::string & port() const
+    {
+        return port_;
+    }
+
+    // Receives until done is set and the socket has then been idle for the receive timeout.
+    std::vector<Arrival> receive(const std::atomic<bool> & done)
+    {
+        std::vector<Arrival> arrivals;
+        std::array<char, protocol::max_packet_size> buffer;
+
+        while (true)
+        {
+            const auto size = ::recv(fd_, buffer.data(), buffer.size(), 0);
+
+            if (size < 0)
+            {
+                if (done.load(std::memory_order_acquire))
+                {
+                    break;
+                }
+
+                continue;
+            }
+
+            const std::uint64_t now = protocol::now_us();
+
+            // Heartbeats repeat a layout that was already captured and would count as duplicates.
+            if (const auto message = protocol::parse(buffer.data(), size);
+                message && (message->flags & protocol::flag_heartbeat) == 0)
+            {
+                arrivals.push_back({std::string(message->layout), now});
+            }
+        }
+
+        return arrivals;
+    }
+
+private:
+    const int fd_;
+    std::string port_;
+};
+
+void report(const std::string & name, std::vector<double> values)
+{
+    std::cout << name << "_count: " << values.size() << "\n";
+
+    if (values.empty())
+    {
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+    std::cout << name << "_p50_us: " << values[values.size() / 2] << "\n"
+        << name << "_p99_us: " << values[values.size() * 99 / 100] << "\n"
+        << name << "_max_us: " << values.back() << "\n";
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const int events = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int rate = argc > 2 ? std::atoi(argv[2]) : 200;
+    const std::chrono::milliseconds coalescing_window(argc > 3 ? std::atoi(argv[3]) : 0);
+
+    Display * const display = XOpenDisplay(NULL);
+
+    if (display == nullptr)
+    {
+        std::cerr << "cannot open the display; run under run_under_xvfb.sh" << std::endl;
+        return 1;
+    }
+
+    XkbDescPtr keyboard = XkbGetKeyboard(display, XkbControlsMask, XkbUseCoreKbd);
+    const int group_count = keyboard != nullptr && keyboard->ctrls != nullptr
+        ? keyboard->ctrls->num_groups
+        : 0;
+
+    if (keyboard != nullptr)
+    {
+        XkbFreeKeyboard(keyboard, 0, True);
+    }
+
+    if (group_count < 2)
+    {
+        std::cerr << "the keymap has " << group_count << " group(s); at least 2 are needed" << std::endl;
+        return 1;
+    }
+
+    // Start from group 0 so that the first switch is a change.
+    XkbLockGroup(display, XkbUseCoreKbd, 0);
+    XSync(display, False);
+
+    Sink sink;
+    Sender sender(
+        {{"127.0.0.1", sink.port()}},
+        TransportOptions{},
+        false,
+        false,
+        keyboard_groups,
+        nullptr,
+        coalescing_window);
+    Probe probe(sender);
+    Reactor reactor;
+    reactor.start();
+
+    if (!reactor.add(probe))
+    {
+        std::cerr << "cannot start the sender" << std::endl;
+        return 1;
+    }
+
+    // Let the transmit stage resolve the sink before the first change.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<Arrival> arrivals;
+    std::atomic<bool> done{false};
+    std::thread receiver([&] { arrivals = sink.receive(done); });
+
+    std::vector<int> groups(events);
+    std::vector<std::uint64_t> switched_us(events);
+    const auto interval = std::chrono::nanoseconds(1000000000 / std::max(1, rate));
+    const std::uint64_t cpu_begin = process_cpu_ns();
+    auto next = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < events; ++i)
+    {
+        groups[i] = (i + 1) % std::min(group_count, 4);
+        switched_us[i] = protocol::now_us();
+        XkbLockGroup(display, XkbUseCoreKbd, groups[i]);
+        XFlush(display);
+
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+
+    // The capture runs for the whole event loop however slow the rate, and then long enough for the
+    // trailing edge of a coalescing window to reach the wire.
+    std::this_thread::sleep_for(coalescing_window + std::chrono::milliseconds(200));
+    done.store(true, std::memory_order_release);
+    receiver.join();
+    const std::uint64_t cpu_end = process_cpu_ns();
+
+    reactor.stop();
+    XCloseDisplay(display);
+
+    // Arrivals are matched to switches in order; a switch without a matching packet was dropped or
+    // coalesced, and a packet repeating the previous layout is a duplicate. The group the sender
+    // announced when it opened arrives before the first switch and is not a change.
+    std::vector<double> latencies_us;
+    std::size_t next_event = 0;
+    std::size_t dropped = 0;
+    std::size_t duplicated = 0;
+    std::string previous_layout;
+
+    for (const Arrival & arrival : arrivals)
+    {
+        if (!switched_us.empty() && arrival.received_us < switched_us.front())
+        {
+            continue;
+        }
+
+        if (arrival.layout == previous_layout)
+        {
+            ++duplicated;
+            continue;
+        }
+
+        previous_layout = arrival.layout;
+
+        while (next_event < groups.size()
+            && keyboard_groups.at(std::to_string(groups[next_event])) != arrival.layout)
+        {
+            ++dropped;
+            ++next_event;
+        }
+
+        if (next_event == groups.size())
+        {
+            break;
+        }
+
+        latencies_us.push_back(static_cast<double>(arrival.received_us - switched_us[next_event]));
+        ++next_event;
+    }
+
+    dropped += groups.size() - next_event;
+
+    std::cout << "events: " << events << "\n"
+        << "rate_per_second: " << rate << "\n"
+        << "packets: " << arrivals.size() << "\n"
+        << "dropped_changes: " << dropped << "\n"
+        << "duplicated_changes: " << duplicated << "\n"
+        << "x_events: " << sender.x_events() << "\n"
+        << "sender_wakeups: " << sender.wakeups() << "\n"
+        << "suppressed_updates: " << sender.suppressed_updates() << "\n"
+        << "capture_cpu_ns_per_event: " << static_cast<double>(probe.cpu_ns) / events << "\n"
+        << "process_cpu_ns_per_event: " << static_cast<double>(cpu_end - cpu_begin) / events << "\n";
+    report("event_to_wire", latencies_us);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#!/bin/sh
+# vi: ts=4 sw=4 tw=100 et
+#
+# Compares the startup time and memory footprint of the tray application with the headless
+# daemon, e.g.
+#   run_under_xvfb.sh startup_footprint.sh ./kbd-layout-sync ./kbd-layout-sync-daemon 5
+#
+# Both read a private ini file that enables the metrics endpoint; startup time is measured from
+# exec to the first successful scrape, which the tray only answers once QApplication is up. After
+# a second to settle, the resident and peak resident set sizes and the CPU time spent so far are
+# read from /proc. The tray needs a display; the daemon also starts its listener, the tray only
+# sets it up. Results are written as JSON lines.
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 tray-executable daemon-executable [runs]" >&2
+    exit 2
+fi
+
+tray=$1
+daemon=$2
+runs=${3:-5}
+
+port=$((36100 + $$ % 1000))
+metrics_port=$((port + 1000))
+
+config_home=$(mktemp -d)
+trap 'rm -rf "${config_home}"' EXIT INT TERM
+
+cat > "${config_home}/kb-layout-sync.ini" <<EOF
+[General]
+receiver_host=127.0.0.1
+receiver_port=${port}
+metrics_address=127.0.0.1:${metrics_port}
+EOF
+
+export XDG_CONFIG_HOME="${config_home}"
+
+clock_ticks=$(getconf CLK_TCK)
+
+now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+status_kb() {
+    awk -v field="$2:" '$1 == field { print $2 }' "/proc/$1/status"
+}
+
+measure() {
+    mode=$1
+    run=$2
+    shift 2
+
+    begin=$(now_ms)
+    "$@" >/dev/null 2>&1 &
+    pid=$!
+
+    tries=0
+    until curl -sf "http://127.0.0.1:${metrics_port}/metrics" >/dev/null 2>&1; do
+        tries=$((tries + 1))
+        if [ "${tries}" -gt 1000 ] || ! kill -0 "${pid}" 2>/dev/null; then
+            echo "${mode} did not start" >&2
+            kill "${pid}" 2>/dev/null || true
+            exit 1
+        fi
+        sleep 0.01
+    done
+
+    startup_ms=$(($(now_ms) - begin))
+    sleep 1
+
+    rss_kb=$(status_kb "${pid}" VmRSS)
+    peak_rss_kb=$(status_kb "${pid}" VmHWM)
+    # utime and stime are fields 14 and 15; the command name in field 2 has no spaces here.
+    cpu_ticks=$(awk '{ print $14 + $15 }' "/proc/${pid}/stat")
+    cpu_ms=$((cpu_ticks * 1000 / clock_ticks))
+
+    kill -TERM "${pid}"
+    wait "${pid}" 2>/dev/null || true
+
+    echo "{\"mode\": \"${mode}\", \"run\": ${run}, \"startup_ms\": ${startup_ms}," \
+        "\"rss_kb\": ${rss_kb}, \"peak_rss_kb\": ${peak_rss_kb}, \"cpu_ms\": ${cpu_ms}}"
+}
+
+run=1
+while [ "${run}" -le "${runs}" ]; do
+    measure tray "${run}" "${tray}"
+    measure daemon "${run}" "${daemon}"
+    run=$((run + 1))
+done
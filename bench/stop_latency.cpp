@@ -0,0 +1,51 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Measures how long removing an idle Listener from a running Reactor blocks, i.e. the time between
+// the request on the control pipe and the reactor thread having closed the handler.
+
+#include "listener.h"
+#include "reactor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+int main(int argc, char * argv[])
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+
+    Reactor reactor;
+    Listener listener("127.0.0.1", "0", TransportOptions{}, [](auto &&...) {});
+    std::vector<double> latencies_us;
+    latencies_us.reserve(iterations);
+
+    reactor.start();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        reactor.add(listener);
+
+        // Let the reactor block in its wait before removing the listener.
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        const auto begin = std::chrono::steady_clock::now();
+        reactor.remove(listener);
+        const auto end = std::chrono::steady_clock::now();
+
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+    }
+
+    reactor.stop();
+    std::sort(latencies_us.begin(), latencies_us.end());
+
+    std::cout << "iterations: " << iterations << "\n"
+        << "min_us: " << latencies_us.front() << "\n"
+        << "p50_us: " << latencies_us[latencies_us.size() / 2] << "\n"
+        << "p99_us: " << latencies_us[latencies_us.size() * 99 / 100] << "\n"
+        << "max_us: " << latencies_us.back() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,292 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Compares loopback UDP with AF_UNIX datagram sockets, bound to a path and in the abstract
+// namespace, as the transport between a sender and a Listener on a Reactor. Reports for each:
+// sustained packets per second, CPU time per packet on the sending thread and on the reactor
+// thread, and the round-trip time of an update and its ack. Results are written as JSON lines.
+//
+//   transport-bench [packets] [round trips] [output file]
+
+#include "endpoint.h"
+#include "listener.h"
+#include "probe.h"
+#include "protocol.h"
+#include "reactor.h"
+#include "transport.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t burst_size = 64;
+// Bursts the sender may be ahead of the listener, see listener-bench.
+constexpr std::size_t bursts_in_flight = 2;
+
+struct Result
+{
+    std::string transport;
+    std::uint64_t packets_sent;
+    std::uint64_t packets_received;
+    double seconds;
+    double send_cpu_ns_per_packet;
+    double receive_cpu_ns_per_packet;
+    double p50_rtt_us;
+    double p99_rtt_us;
+};
+
+// The listener's socket address and a sending socket of the same family; AF_UNIX senders are bound
+// to an abstract name so that acks can reach them.
+int make_sender(
+    const std::string & host,
+    const Listener & listener,
+    struct sockaddr_storage & address,
+    socklen_t & address_size)
+{
+    if (is_unix_host(host))
+    {
+        address_size = make_unix_address(unix_socket_name(host), address);
+
+        const int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+        const sa_family_t family = AF_UNIX;
+        ::bind(fd, reinterpret_cast<const struct sockaddr *>(&family), sizeof(family));
+        return fd;
+    }
+
+    const auto endpoint = parse_endpoint(listener.socket_stats().front().address);
+    auto & ipv4 = reinterpret_cast<struct sockaddr_in &>(address);
+
+    address = {};
+    ipv4.sin_family = AF_INET;
+    ipv4.sin_port = htons(std::atoi(endpoint->port.c_str()));
+    ::inet_pton(AF_INET, endpoint->host.c_str(), &ipv4.sin_addr);
+    address_size = sizeof(ipv4);
+
+    return ::socket(AF_INET, SOCK_DGRAM, 0);
+}
+
+std::size_t encode(
+    std::array<char, protocol::max_packet_size> & packet,
+    const std::uint32_t sequence,
+    const std::uint8_t flags)
+{
+    protocol::Message message;
+    message.flags = flags;
+    message.origin = 1;
+    message.sequence = sequence;
+    message.layout = sequence % 2 == 0 ? "us" : "ru";
+    return protocol::encode(message, packet.data(), packet.size());
+}
+
+Result run(
+    const std::string & transport,
+    const std::string & host,
+    const std::uint64_t packet_count,
+    const std::size_t round_trips)
+{
+    std::atomic<std::uint64_t> callbacks{0};
+
+    Listener listener(
+        host,
+        "0",
+        TransportOptions{},
+        [&](const protocol::Message &)
+        {
+            callbacks.fetch_add(1, std::memory_order_release);
+        });
+
+    const auto received = [&]
+    {
+        return callbacks.load(std::memory_order_acquire)
+            + listener.coalesced_packets()
+            + listener.stale_packets()
+            + listener.rejected_packets();
+    };
+
+    Probe probe(listener);
+    Reactor reactor;
+    reactor.start();
+
+    if (!reactor.add(probe))
+    {
+        std::cerr << "cannot open the listener on " << host << std::endl;
+        std::exit(1);
+    }
+
+    struct sockaddr_storage address;
+    socklen_t address_size = 0;
+    const int send_fd = make_sender(host, listener, address, address_size);
+
+    std::vector<std::array<char, protocol::max_packet_size>> packets(burst_size);
+    std::vector<struct iovec> iovecs(burst_size);
+    std::vector<struct mmsghdr> headers(burst_size);
+
+    const auto begin = Clock::now();
+    std::uint64_t send_cpu_ns = 0;
+    std::uint64_t sent = 0;
+
+    while (sent < packet_count)
+    {
+        while (sent - received() > bursts_in_flight * burst_size)
+        {
+            std::this_thread::yield();
+        }
+
+        const std::uint64_t cpu_begin = thread_cpu_ns();
+        const std::size_t count = std::min<std::uint64_t>(burst_size, packet_count - sent);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto sequence = static_cast<std::uint32_t>(sent + i + 1);
+            iovecs[i] = {packets[i].data(), encode(packets[i], sequence, 0)};
+            headers[i] = {};
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &address;
+            headers[i].msg_hdr.msg_namelen = address_size;
+        }
+
+        const int batch_sent = ::sendmmsg(send_fd, headers.data(), count, 0);
+        send_cpu_ns += thread_cpu_ns() - cpu_begin;
+
+        if (batch_sent <= 0)
+        {
+            std::cerr << "sendmmsg() failed" << std::endl;
+            std::exit(1);
+        }
+
+        sent += batch_sent;
+    }
+
+    // The tail is waited for only until the listener stops making progress, see listener-bench.
+    std::uint64_t last_received = received();
+    auto end = Clock::now();
+
+    while (last_received < sent && Clock::now() - end < std::chrono::milliseconds(200))
+    {
+        std::this_thread::yield();
+
+        if (const std::uint64_t now_received = received(); now_received != last_received)
+        {
+            last_received = now_received;
+            end = Clock::now();
+        }
+    }
+
+    const std::uint64_t packets_received = received();
+    const std::uint64_t receive_cpu_ns = probe.cpu_ns;
+
+    struct timeval receive_timeout = {1, 0};
+    ::setsockopt(send_fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+
+    std::vector<double> rtts_us;
+    std::array<char, protocol::max_packet_size> ack;
+
+    for (std::size_t i = 0; i < round_trips; ++i)
+    {
+        const std::size_t size = encode(
+            packets[0], static_cast<std::uint32_t>(sent + i + 1), protocol::flag_ack_requested);
+        const auto sent_at = Clock::now();
+
+        ::sendto(
+            send_fd,
+            packets[0].data(),
+            size,
+            0,
+            reinterpret_cast<const struct sockaddr *>(&address),
+            address_size);
+
+        if (::recv(send_fd, ack.data(), ack.size(), 0) > 0)
+        {
+            const auto rtt = Clock::now() - sent_at;
+            rtts_us.push_back(std::chrono::duration<double, std::micro>(rtt).count());
+        }
+    }
+
+    reactor.stop();
+    ::close(send_fd);
+
+    std::sort(rtts_us.begin(), rtts_us.end());
+
+    Result result = {};
+    result.transport = transport;
+    result.packets_sent = sent;
+    result.packets_received = packets_received;
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.send_cpu_ns_per_packet =
+        static_cast<double>(send_cpu_ns) / std::max<std::uint64_t>(1, sent);
+    result.receive_cpu_ns_per_packet =
+        static_cast<double>(receive_cpu_ns) / std::max<std::uint64_t>(1, packets_received);
+
+    if (!rtts_us.empty())
+    {
+        result.p50_rtt_us = rtts_us[rtts_us.size() / 2];
+        result.p99_rtt_us = rtts_us[rtts_us.size() * 99 / 100];
+    }
+
+    return result;
+}
+
+std::string to_json(const Result & result)
+{
+    std::ostringstream stream;
+    stream << "{\"transport\": \"" << result.transport
+        << "\", \"packets_sent\": " << result.packets_sent
+        << ", \"packets_received\": " << result.packets_received
+        << ", \"packets_per_second\": " << result.packets_received / result.seconds
+        << ", \"send_cpu_ns_per_packet\": " << result.send_cpu_ns_per_packet
+        << ", \"receive_cpu_ns_per_packet\": " << result.receive_cpu_ns_per_packet
+        << ", \"p50_rtt_us\": " << result.p50_rtt_us
+        << ", \"p99_rtt_us\": " << result.p99_rtt_us
+        << "}";
+    return stream.str();
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    const std::uint64_t packets = argc > 1 ? std::atoll(argv[1]) : 200000;
+    const std::size_t round_trips = argc > 2 ? std::atoll(argv[2]) : 10000;
+
+    std::ofstream file;
+
+    if (argc > 3)
+    {
+        file.open(argv[3]);
+
+        if (!file)
+        {
+            std::cerr << "cannot open " << argv[3] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostream & output = file.is_open() ? file : std::cout;
+    const std::string name = "kbd-layout-sync-bench-" + std::to_string(::getpid());
+
+    const std::string path = "/tmp/" + name + ".sock";
+
+    output << to_json(run("udp", "127.0.0.1", packets, round_trips)) << std::endl;
+    output << to_json(run("unix", "unix:" + path, packets, round_trips)) << std::endl;
+    output << to_json(run("unix_abstract", "unix:@" + name, packets, round_trips)) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+// vi: ts=4 sw=4 tw=100 et
+
+// Runs the service without a tray icon or any other GUI, e.g. on a server or from a session's
+// autostart. Settings come from the tray application's ini file, or another one given with
+// --config, and the flags below override them. SIGHUP re-reads the file and applies the changes
+// like the settings window does; SIGTERM and SIGINT stop the daemon.
+
+#include "config.h"
+#include "endpoint.h"
+#include "service.h"
+#include "settings.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+
+namespace
+{
+
+enum class Role
+{
+    Receiver,
+    Transmitter,
+    Peer
+};
+
+struct Options
+{
+    Role role = Role::Receiver;
+    std::filesystem::path config = settings_path();
+    std::optional<std::string> host;
+    std::optional<std::string> port;
+    std::vector<Endpoint> receivers;
+    bool reliable_delivery = false;
+    std::optional<std::string> metrics_address;
+};
+
+void print_usage(std::ostream & stream, const char * program)
+{
+    stream << "usage: " << program << " [options]\n"
+        "\n"
+        "  --receiver           apply layouts received from other hosts (default)\n"
+        "  --transmitter        send local keyboard group changes\n"
+        "  --peer               both, with versioned updates\n"
+        "  --config FILE        read settings from FILE instead of the tray application's\n"
+        "  --host HOST          receiver host\n"
+        "  --port PORT          receiver port\n"
+        "  --send-to ENDPOINT   send to HOST:PORT or unix:PATH; may be repeated\n"
+        "  --reliable           acknowledge and retransmit updates\n"
+        "  --metrics ADDRESS    serve Prometheus metrics on HOST:PORT or unix:PATH\n"
+        "  --help               show this help\n";
+}
+
+// Returns nullopt after printing an error or the help; exit_code tells which.
+std::optional<Options> parse_options(const int argc, char * argv[], int & exit_code)
+{
+    Options options;
+    exit_code = 2;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+
+        const auto value = [&]() -> std::optional<std::string>
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << option << " needs a value" << std::endl;
+                return std::nullopt;
+            }
+
+            return std::string{argv[++i]};
+        };
+
+        if (option == "--receiver")
+        {
+            options.role = Role::Receiver;
+        }
+        else if (option == "--transmitter")
+        {
+            options.role = Role::Transmitter;
+        }
+        else if (option == "--peer")
+        {
+            options.role = Role::Peer;
+        }
+        else if (option == "--reliable")
+        {
+            options.reliable_delivery = true;
+        }
+        else if (option == "--help" || option == "-h")
+        {
+            print_usage(std::cout, argv[0]);
+            exit_code = 0;
+            return std::nullopt;
+        }
+        else if (option == "--config" || option == "--host" || option == "--port"
+            || option == "--send-to" || option == "--metrics")
+        {
+            const auto argument = value();
+
+            if (!argument)
+            {
+                return std::nullopt;
+            }
+
+            if (option == "--config")
+            {
+                options.config = *argument;
+            }
+            else if (option == "--host")
+            {
+                options.host = *argument;
+            }
+            else if (option == "--port")
+            {
+                options.port = *argument;
+            }
+            else if (option == "--metrics")
+            {
+                options.metrics_address = *argument;
+            }
+            else if (auto receiver = parse_endpoint(*argument))
+            {
+                options.receivers.push_back(std::move(*receiver));
+            }
+            else
+            {
+                std::cerr << "invalid endpoint " << *argument << std::endl;
+                return std::nullopt;
+            }
+        }
+        else
+        {
+            std::cerr << "unknown option " << option << std::endl;
+            print_usage(std::cerr, argv[0]);
+            return std::nullopt;
+        }
+    }
+
+#if !HAS_X11
+    if (options.role != Role::Receiver)
+    {
+        std::cerr << "built without X11: only --receiver is available" << std::endl;
+        return std::nullopt;
+    }
+#endif
+
+    return options;
+}
+
+Settings load(const Options & options)
+{
+    // A missing file would silently give the defaults; only the tray's own file may not exist yet.
+    if (options.config != settings_path() && !std::filesystem::exists(options.config))
+    {
+        throw std::runtime_error("cannot read " + options.config.string());
+    }
+
+    Settings settings = load_settings(options.config);
+
+    if (options.host)
+    {
+        settings.receiver_host = *options.host;
+    }
+
+    if (options.port)
+    {
+        settings.receiver_port = *options.port;
+    }
+
+    if (!options.receivers.empty())
+    {
+        settings.receivers = options.receivers;
+    }
+
+    if (options.reliable_delivery)
+    {
+        settings.reliable_delivery = true;
+    }
+
+    if (options.metrics_address)
+    {
+        settings.metrics_address = *options.metrics_address;
+    }
+
+    return settings;
+}
+
+bool start(Service & service, const Role role)
+{
+    switch (role)
+    {
+    case Role::Receiver:
+        return service.start_listener();
+#if HAS_X11
+    case Role::Transmitter:
+        return service.start_sender();
+    case Role::Peer:
+        return service.start_peer();
+#else
+    case Role::Transmitter:
+    case Role::Peer:
+        break;
+#endif
+    }
+
+    return false;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    int exit_code = 0;
+    const std::optional<Options> options = parse_options(argc, argv, exit_code);
+
+    if (!options)
+    {
+        return exit_code;
+    }
+
+    // Blocked before any thread starts, so that every thread inherits the mask and the signals are
+    // only ever taken by sigwait() below.
+    sigset_t signals;
+    ::sigemptyset(&signals);
+    ::sigaddset(&signals, SIGTERM);
+    ::sigaddset(&signals, SIGINT);
+    ::sigaddset(&signals, SIGHUP);
+
+    if (const int error = ::pthread_sigmask(SIG_BLOCK, &signals, nullptr); error != 0)
+    {
+        std::cerr << "Error: pthread_sigmask(): " << std::strerror(error) << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Service service(load(*options));
+
+        if (!start(service, options->role))
+        {
+            return 1;
+        }
+
+        for (;;)
+        {
+            int signal = 0;
+
+            if (::sigwait(&signals, &signal) != 0)
+            {
+                throw std::runtime_error("sigwait()");
+            }
+
+            if (signal != SIGHUP)
+            {
+                break;
+            }
+
+            // A file that became unreadable keeps the running settings.
+            try
+            {
+                service.apply_settings(load(*options));
+            }
+            catch (const std::exception & e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+
+        service.stop();
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
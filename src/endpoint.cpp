@@ -0,0 +1,75 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "endpoint.h"
+
+#include <string_view>
+
+namespace
+{
+
+constexpr std::string_view unix_scheme = "unix:";
+
+}
+
+bool is_unix_host(const std::string & host)
+{
+    return host.size() > unix_scheme.size() && host.compare(0, unix_scheme.size(), unix_scheme) == 0;
+}
+
+std::string unix_socket_name(const std::string & host)
+{
+    return host.substr(unix_scheme.size());
+}
+
+std::optional<Endpoint> parse_endpoint(const std::string & str)
+{
+    if (is_unix_host(str))
+    {
+        return Endpoint{str, {}};
+    }
+
+    const std::size_t colon = str.rfind(':');
+
+    if (colon == std::string::npos || colon == 0 || colon + 1 == str.size())
+    {
+        return std::nullopt;
+    }
+
+    std::string host = str.substr(0, colon);
+
+    if (host.front() == '[' && host.back() == ']')
+    {
+        host = host.substr(1, host.size() - 2);
+    }
+    else if (host.find(':') != std::string::npos)
+    {
+        return std::nullopt;
+    }
+
+    return Endpoint{std::move(host), str.substr(colon + 1)};
+}
+
+std::string to_string(const Endpoint & endpoint)
+{
+    if (is_unix_host(endpoint.host))
+    {
+        return endpoint.host;
+    }
+
+    if (endpoint.host.find(':') != std::string::npos)
+    {
+        return "[" + endpoint.host + "]:" + endpoint.port;
+    }
+
+    return endpoint.host + ":" + endpoint.port;
+}
+
+bool operator==(const Endpoint & lhs, const Endpoint & rhs)
+{
+    return lhs.host == rhs.host && lhs.port == rhs.port;
+}
+
+bool operator!=(const Endpoint & lhs, const Endpoint & rhs)
+{
+    return !(lhs == rhs);
+}
@@ -0,0 +1,25 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <optional>
+#include <string>
+
+struct Endpoint
+{
+    std::string host;
+    std::string port;
+};
+
+// Hosts of the form "unix:/path" or, for the abstract namespace, "unix:@name" stand for an AF_UNIX
+// datagram socket; such endpoints have no port.
+bool is_unix_host(const std::string & host);
+// The path, or "@name", of a "unix:" host.
+std::string unix_socket_name(const std::string & host);
+
+// Parses "host:port" or a "unix:" host; IPv6 literals must be bracketed, e.g. "[::1]:36032".
+std::optional<Endpoint> parse_endpoint(const std::string & str);
+std::string to_string(const Endpoint & endpoint);
+
+bool operator==(const Endpoint & lhs, const Endpoint & rhs);
+bool operator!=(const Endpoint & lhs, const Endpoint & rhs);
@@ -0,0 +1,154 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+
+constexpr std::array<const char *, LatencyTracer::stage_count> stage_names = {
+    "network",
+    "parse",
+    "apply",
+    "total"};
+
+int log2_floor(const std::uint64_t value)
+{
+    int result = 0;
+
+    for (std::uint64_t rest = value; rest > 1; rest >>= 1)
+    {
+        ++result;
+    }
+
+    return result;
+}
+
+std::string format_ms(const std::uint64_t value_ns)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f ms", value_ns / 1e6);
+    return buffer;
+}
+
+}
+
+void LatencyHistogram::record(const std::uint64_t value_ns)
+{
+    buckets_[bucket_of(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+
+    while (value_ns > max && !max_.compare_exchange_weak(max, value_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::uint64_t LatencyHistogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::percentile(const double fraction) const
+{
+    std::array<std::uint64_t, bucket_count> counts;
+    std::uint64_t total = 0;
+
+    for (std::size_t i = 0; i < bucket_count; ++i)
+    {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(fraction * total)));
+    std::uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < bucket_count; ++i)
+    {
+        seen += counts[i];
+
+        if (seen >= target)
+        {
+            return std::min(upper_bound(i), max());
+        }
+    }
+
+    return max();
+}
+
+std::uint64_t LatencyHistogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+// Values below sub_buckets get a bucket each; above, every power of two is split into sub_buckets
+// linear buckets.
+std::size_t LatencyHistogram::bucket_of(const std::uint64_t value_ns)
+{
+    if (value_ns < sub_buckets)
+    {
+        return value_ns;
+    }
+
+    const int exponent = log2_floor(value_ns);
+    const std::size_t mantissa = (value_ns >> (exponent - 3)) & (sub_buckets - 1);
+    return (exponent - 2) * sub_buckets + mantissa;
+}
+
+std::uint64_t LatencyHistogram::upper_bound(const std::size_t bucket)
+{
+    if (bucket < sub_buckets)
+    {
+        return bucket;
+    }
+
+    const int shift = static_cast<int>(bucket / sub_buckets) - 1;
+    const std::uint64_t lower = (sub_buckets + bucket % sub_buckets) << shift;
+    return lower + (std::uint64_t{1} << shift) - 1;
+}
+
+void LatencyTracer::record(const LatencyStage stage, const std::uint64_t duration_ns)
+{
+    histograms_[static_cast<std::size_t>(stage)].record(duration_ns);
+}
+
+const LatencyHistogram & LatencyTracer::histogram(const LatencyStage stage) const
+{
+    return histograms_[static_cast<std::size_t>(stage)];
+}
+
+std::string LatencyTracer::report() const
+{
+    std::string result;
+
+    for (std::size_t i = 0; i < stage_count; ++i)
+    {
+        const LatencyHistogram & histogram = histograms_[i];
+
+        if (histogram.count() == 0)
+        {
+            continue;
+        }
+
+        if (!result.empty())
+        {
+            result += '\n';
+        }
+
+        result += std::string(stage_names[i]) + ": p50 " + format_ms(histogram.percentile(0.5))
+            + ", p99 " + format_ms(histogram.percentile(0.99))
+            + ", max " + format_ms(histogram.max())
+            + " (" + std::to_string(histogram.count()) + ")";
+    }
+
+    return result;
+}
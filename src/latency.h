@@ -0,0 +1,62 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Log-linear histogram of durations in nanoseconds. record() is lock-free and may be called from
+// any thread; readers see a slightly inconsistent snapshot at worst. Values are kept with about
+// 12% relative precision.
+class LatencyHistogram
+{
+public:
+    void record(std::uint64_t value_ns);
+
+    std::uint64_t count() const;
+    // Upper bound of the bucket holding the given fraction of values; 0 if empty.
+    std::uint64_t percentile(double fraction) const;
+    std::uint64_t max() const;
+
+private:
+    static constexpr std::size_t sub_buckets = 8;
+    static constexpr std::size_t bucket_count = 62 * sub_buckets;
+
+    static std::size_t bucket_of(std::uint64_t value_ns);
+    static std::uint64_t upper_bound(std::size_t bucket);
+
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+enum class LatencyStage
+{
+    // Capture on the sender to receipt on the receiver; needs synchronized clocks.
+    Network,
+    // Receipt to the packet being parsed and selected from its batch.
+    Parse,
+    // LayoutBackend::set_layout(), including waiting for the applier.
+    Apply,
+    // Capture on the sender to set_layout() returning on the receiver.
+    Total
+};
+
+// Per-stage latencies of traced layout updates, see protocol::flag_capture_timestamp.
+class LatencyTracer
+{
+public:
+    static constexpr std::size_t stage_count = 4;
+
+    void record(LatencyStage stage, std::uint64_t duration_ns);
+    const LatencyHistogram & histogram(LatencyStage stage) const;
+
+    // One line per stage with its p50, p99 and max, or an empty string if nothing was traced.
+    std::string report() const;
+
+private:
+    std::array<LatencyHistogram, stage_count> histograms_;
+};
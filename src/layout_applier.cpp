@@ -0,0 +1,114 @@
+#include "layout_applier.h"
+
+#include <cassert>
+
+LayoutApplier::LayoutApplier(std::shared_ptr<const LayoutBackend> backend, LayoutTable layouts)
+    : backend_{std::move(backend)}
+    , layouts_{std::move(layouts)}
+{
+    assert(backend_ != nullptr);
+}
+
+bool LayoutApplier::apply(const std::string_view layout)
+{
+    if (layout.empty())
+    {
+        return false;
+    }
+
+    const std::scoped_lock lock{mutex_};
+
+    const LayoutTable::Id id = layouts_.intern(layout);
+
+    if (id != LayoutTable::none && id == active_layout_)
+    {
+        skipped_count_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    active_layout_ = id;
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    if (id != LayoutTable::none)
+    {
+        backend_->set_layout(layouts_.name(id));
+    }
+    else
+    {
+        // The table is full; apply without caching.
+        backend_->set_layout(std::string{layout});
+    }
+
+    const auto duration = std::chrono::steady_clock::now() - begin;
+    set_layout_ns_.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+        std::memory_order_relaxed);
+    applied_count_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LayoutApplier::reconcile(const std::string_view layout)
+{
+    if (layout.empty())
+    {
+        return false;
+    }
+
+    const std::string active = backend_->get_layout();
+
+    {
+        const std::scoped_lock lock{mutex_};
+        active_layout_ = layouts_.intern(active);
+    }
+
+    if (active == layout || !apply(layout))
+    {
+        return false;
+    }
+
+    repaired_count_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void LayoutApplier::refresh()
+{
+    const std::string layout = backend_->get_layout();
+
+    const std::scoped_lock lock{mutex_};
+    active_layout_ = layouts_.intern(layout);
+}
+
+void LayoutApplier::set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups)
+{
+    LayoutTable layouts{keyboard_groups};
+
+    const std::scoped_lock lock{mutex_};
+
+    if (active_layout_ != LayoutTable::none)
+    {
+        active_layout_ = layouts.intern(layouts_.name(active_layout_));
+    }
+
+    layouts_ = std::move(layouts);
+}
+
+std::uint64_t LayoutApplier::applied_count() const
+{
+    return applied_count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LayoutApplier::skipped_count() const
+{
+    return skipped_count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LayoutApplier::repaired_count() const
+{
+    return repaired_count_.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LayoutApplier::set_layout_time() const
+{
+    return std::chrono::nanoseconds{set_layout_ns_.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "layout_backend.h"
+#include "routing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Applies received layouts through a LayoutBackend, skipping requests for the layout that is already
+// active. The cached layout must be refreshed on local XKB state changes to stay correct.
+class LayoutApplier
+{
+public:
+    LayoutApplier(std::shared_ptr<const LayoutBackend> backend, LayoutTable layouts = LayoutTable{});
+
+    // Returns whether the backend was called.
+    bool apply(std::string_view layout);
+    // For heartbeats: reads the active layout back from the backend, as the cache may be stale, and
+    // applies layout only if it differs. Returns whether the backend's layout was changed.
+    bool reconcile(std::string_view layout);
+    void refresh();
+    // Replaces the layout table after the keyboard groups were edited; the cached active layout is
+    // carried over.
+    void set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups);
+
+    std::uint64_t applied_count() const;
+    std::uint64_t skipped_count() const;
+    // Reconciliations that found a different layout active.
+    std::uint64_t repaired_count() const;
+    // Total time spent in LayoutBackend::set_layout(), over applied_count() calls.
+    std::chrono::nanoseconds set_layout_time() const;
+
+private:
+    const std::shared_ptr<const LayoutBackend> backend_;
+    std::mutex mutex_;
+    LayoutTable layouts_;
+    // LayoutTable::none while the active layout is unknown.
+    LayoutTable::Id active_layout_ = LayoutTable::none;
+    std::atomic<std::uint64_t> applied_count_{0};
+    std::atomic<std::uint64_t> skipped_count_{0};
+    std::atomic<std::uint64_t> repaired_count_{0};
+    std::atomic<std::int64_t> set_layout_ns_{0};
+};
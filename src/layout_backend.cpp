@@ -0,0 +1,30 @@
+#include "layout_backend.h"
+#include "config.h"
+#include "settings.h"
+#include "xkb_switch_lib.h"
+
+#if HAS_X11
+#include "xkb_native_backend.h"
+#endif
+
+#include <iostream>
+#include <stdexcept>
+
+std::shared_ptr<const LayoutBackend> make_layout_backend(const Settings & settings)
+{
+#if HAS_X11
+    if (settings.layout_backend == LayoutBackendType::Native)
+    {
+        try
+        {
+            return std::make_shared<XkbNativeBackend>();
+        }
+        catch (const std::exception & e)
+        {
+            std::cerr << "Error: " << e.what() << ", falling back to libxkbswitch" << std::endl;
+        }
+    }
+#endif
+
+    return std::make_shared<XkbSwitchLib>(settings.xkbswitchlib_path);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+struct Settings;
+
+// Switches the keyboard layout of the local display.
+class LayoutBackend
+{
+public:
+    virtual ~LayoutBackend() = default;
+
+    virtual std::string get_layout() const = 0;
+    virtual void set_layout(const std::string & layout) const = 0;
+};
+
+// Creates the backend selected in settings, falling back to libxkbswitch if the native one cannot
+// be initialized.
+std::shared_ptr<const LayoutBackend> make_layout_backend(const Settings & settings);
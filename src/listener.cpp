@@ -1,31 +1,128 @@
 #include "listener.h"
+#include "endpoint.h"
 
+#if HAS_IO_URING
+#include "uring_receiver.h"
+#endif
+
+#include <array>
 #include <cassert>
-#include <regex>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 #include <stdexcept>
-#include <vector>
+#include <tuple>
 
 #include <QScopeGuard>
 
+#include <errno.h>
 #include <netdb.h>
-#include <poll.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+namespace
+{
+
+void send_ack(
+    const int fd,
+    const protocol::Message & message,
+    const struct sockaddr_storage & sender,
+    const socklen_t sender_size)
+{
+    protocol::Message ack;
+    ack.type = protocol::MessageType::Ack;
+    ack.origin = message.origin;
+    ack.sequence = message.sequence;
+    ack.timestamp_us = message.timestamp_us;
+
+    std::array<char, protocol::header_size> packet;
+    const std::size_t packet_size = protocol::encode(ack, packet.data(), packet.size());
+
+    // Best effort: a lost ack only causes a retransmission.
+    ::sendto(
+        fd,
+        packet.data(),
+        packet_size,
+        MSG_DONTWAIT,
+        reinterpret_cast<const struct sockaddr *>(&sender),
+        sender_size);
+}
+
+// Tracks the newest sequence number seen from each sender; returns false for packets that are
+// duplicates of, or older than, one already accepted.
+bool accept_sequence(
+    std::unordered_map<std::uint32_t, std::uint32_t> & last_sequences,
+    const protocol::Message & message)
+{
+    const auto [it, inserted] = last_sequences.try_emplace(message.origin, message.sequence);
+
+    if (inserted)
+    {
+        return true;
+    }
+
+    // Serial number arithmetic, so that wrapping around does not stall a sender.
+    if (static_cast<std::int32_t>(message.sequence - it->second) <= 0)
+    {
+        return false;
+    }
+
+    it->second = message.sequence;
+    return true;
+}
+
+bool trusted_sender(const ReceiveBatch & batch, const std::size_t index)
+{
+#ifdef __linux__
+    const auto credentials = batch.credentials(index);
+    return credentials && (credentials->uid == 0 || credentials->uid == ::geteuid());
+#else
+    // The socket file is accessible to its owner only; there are no abstract sockets here.
+    (void)batch;
+    (void)index;
+    return true;
+#endif
+}
+
+}
+
 Listener::Listener(
     const std::string & host,
     const std::string & port,
-    OnLayoutReceived on_layout_received)
+    const TransportOptions & transport,
+    OnLayoutReceived on_layout_received,
+    std::shared_ptr<LatencyTracer> latency_tracer,
+    const ReceiveBackend receive_backend)
     : host_{host}
     , port_{port}
+    , transport_{transport}
     , on_layout_received_{std::move(on_layout_received)}
+    , latency_tracer_{std::move(latency_tracer)}
+    , receive_backend_{receive_backend}
+    , batch_{std::make_unique<ReceiveBatch>()}
 {
     assert(on_layout_received_ != nullptr);
 }
 
-void Listener::run()
+Listener::~Listener()
+{
+    close();
+}
+
+std::vector<int> Listener::open()
 {
+    if (is_unix_host(host_))
+    {
+        open_unix_socket(unix_socket_name(host_));
+        last_sequences_.clear();
+        return {sockets_.front()->fd};
+    }
+
     struct addrinfo hints = {};
     struct addrinfo * server_info = nullptr;
 
@@ -33,81 +130,413 @@ void Listener::run()
     hints.ai_socktype = SOCK_DGRAM;
     hints.ai_flags = AI_PASSIVE;
 
-    if (::getaddrinfo(host_.c_str(), port_.c_str(), &hints, &server_info) != 0)
+    // Binding to the group address rather than the wildcard keeps unrelated unicast traffic to the
+    // same port out of a multicast listener.
+    const std::string & host =
+        transport_.mode == TransportMode::Multicast ? transport_.multicast_group : host_;
+
+    // An empty host resolves to the wildcard address of every available family.
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port_.c_str(), &hints, &server_info) != 0)
     {
         throw std::runtime_error("getaddrinfo()");
     }
 
-    const int listen_fd = ::socket(
-        server_info->ai_family,
-        server_info->ai_socktype,
-        server_info->ai_protocol);
+    const auto server_info_guard = qScopeGuard([&]
+    {
+        ::freeaddrinfo(server_info);
+    });
 
-    const auto guard = qScopeGuard([&]
+    auto sockets_guard = qScopeGuard([&]
     {
-        ::close(listen_fd);
+        close();
+    });
+
+    std::string error;
+
+    for (const struct addrinfo * address_info = server_info;
+        address_info != nullptr;
+        address_info = address_info->ai_next)
+    {
+        try
+        {
+            open_socket(*address_info);
+        }
+        catch (const std::exception & e)
+        {
+            error = e.what();
+        }
+    }
+
+    if (sockets_.empty())
+    {
+        throw std::runtime_error(error);
+    }
+
+    if (!error.empty())
+    {
+        std::cerr << "Warning: not listening on every address of " << host << ": " << error << std::endl;
+    }
+
+    sockets_guard.dismiss();
+    last_sequences_.clear();
+
+    std::vector<int> fds;
+
+    for (const auto & socket : sockets_)
+    {
+        fds.push_back(socket->watched_fd());
+    }
+
+    return fds;
+}
+
+void Listener::close()
+{
+    const std::scoped_lock lock{sockets_mutex_};
+
+    // Socket closes its fd and io_uring.
+    sockets_.clear();
+}
+
+std::vector<ListenerSocketStats> Listener::socket_stats() const
+{
+    const std::scoped_lock lock{sockets_mutex_};
+    std::vector<ListenerSocketStats> stats;
+
+    for (const auto & socket : sockets_)
+    {
+        stats.push_back({
+            socket->address,
+            socket->packets.load(std::memory_order_relaxed),
+            socket->batches.load(std::memory_order_relaxed),
+            socket->receive_syscalls.load(std::memory_order_relaxed),
+            socket->watched_fd() == socket->fd ? ReceiveBackend::Socket : ReceiveBackend::IoUring});
+    }
+
+    return stats;
+}
+
+void Listener::open_socket(const struct addrinfo & address_info)
+{
+    const int fd = ::socket(address_info.ai_family, address_info.ai_socktype, address_info.ai_protocol);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("socket()");
+    }
+
+    auto socket_guard = qScopeGuard([&]
+    {
+        ::close(fd);
     });
 
     int sockopt = 1;
-    if (::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &sockopt, sizeof(sockopt)) != 0)
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &sockopt, sizeof(sockopt)) != 0)
     {
         throw std::runtime_error("setsockopt()");
     }
 
-    if (::bind(listen_fd, server_info->ai_addr, server_info->ai_addrlen) != 0)
+    // Otherwise the IPv6 wildcard socket would also claim the port for IPv4 and the IPv4 socket
+    // could not bind.
+    if (address_info.ai_family == AF_INET6
+        && ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &sockopt, sizeof(sockopt)) != 0)
+    {
+        throw std::runtime_error("setsockopt()");
+    }
+
+    if (::bind(fd, address_info.ai_addr, address_info.ai_addrlen) != 0)
     {
         throw std::runtime_error("bind()");
     }
 
-    ::freeaddrinfo(server_info);
+    if (transport_.mode == TransportMode::Multicast)
+    {
+        join_multicast_group(fd, address_info.ai_addr, transport_.multicast_interface);
+    }
 
-    struct pollfd poll_fd{listen_fd, POLLIN, 0};
-    constexpr std::size_t buffer_size = 1024;
-    std::vector<char> buffer(buffer_size);
+    auto socket = std::make_unique<Socket>();
+    socket->fd = fd;
+    socket_guard.dismiss();
 
-    while (true)
+    if (receive_backend_ == ReceiveBackend::IoUring)
     {
-        if (::poll(&poll_fd, 1, 1000) < 0)
+#if HAS_IO_URING
+        try
         {
-            throw std::runtime_error("poll()");
+            socket->uring = std::make_unique<UringReceiver>(fd);
         }
+        catch (const std::exception & e)
+        {
+            std::cerr << "Warning: io_uring is not available, receiving with recvmmsg(): "
+                << e.what() << std::endl;
+        }
+#else
+        std::cerr << "Warning: built without io_uring, receiving with recvmmsg()" << std::endl;
+#endif
+    }
 
-        if (should_stop())
+    std::array<char, NI_MAXHOST> host;
+    std::array<char, NI_MAXSERV> port;
+    // The bound address rather than the requested one, so that port 0 shows the port picked.
+    struct sockaddr_storage bound_address = {};
+    socklen_t bound_address_size = sizeof(bound_address);
+
+    if (::getsockname(fd, reinterpret_cast<struct sockaddr *>(&bound_address), &bound_address_size) == 0
+        && ::getnameinfo(
+            reinterpret_cast<const struct sockaddr *>(&bound_address),
+            bound_address_size,
+            host.data(),
+            host.size(),
+            port.data(),
+            port.size(),
+            NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+    {
+        socket->address = to_string(Endpoint{host.data(), port.data()});
+    }
+
+    const std::scoped_lock lock{sockets_mutex_};
+    sockets_.push_back(std::move(socket));
+}
+
+Listener::Socket::Socket() = default;
+
+Listener::Socket::~Socket()
+{
+#if HAS_IO_URING
+    // The io_uring goes first: it still has a receive pending on the socket.
+    uring.reset();
+#endif
+    ::close(fd);
+
+    if (!path.empty())
+    {
+        ::unlink(path.c_str());
+    }
+}
+
+int Listener::Socket::watched_fd() const
+{
+#if HAS_IO_URING
+    if (uring)
+    {
+        return uring->fd();
+    }
+#endif
+
+    return fd;
+}
+
+std::size_t Listener::Socket::receive(ReceiveBatch & batch)
+{
+#if HAS_IO_URING
+    if (uring)
+    {
+        const std::uint64_t syscalls = uring->syscalls();
+        const std::size_t count = uring->receive(batch);
+        receive_syscalls.fetch_add(uring->syscalls() - syscalls, std::memory_order_relaxed);
+        return count;
+    }
+#endif
+
+    const std::uint64_t syscalls = batch.syscalls;
+    const std::size_t count = batch.receive(fd);
+    receive_syscalls.fetch_add(batch.syscalls - syscalls, std::memory_order_relaxed);
+    return count;
+}
+
+void Listener::open_unix_socket(const std::string & name)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("socket()");
+    }
+
+    auto socket_guard = qScopeGuard([&]
+    {
+        ::close(fd);
+    });
+
+    bind_unix_socket(fd, name);
+
+    const bool abstract = name.front() == '@';
+
+    if (!abstract && ::chmod(name.c_str(), S_IRUSR | S_IWUSR) != 0)
+    {
+        ::unlink(name.c_str());
+        throw std::runtime_error("chmod()");
+    }
+
+#ifdef __linux__
+    // The abstract namespace has no permissions; the kernel attaches the sender's credentials to
+    // every datagram instead.
+    int sockopt = 1;
+    if (::setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &sockopt, sizeof(sockopt)) != 0)
+    {
+        if (!abstract)
+        {
+            ::unlink(name.c_str());
+        }
+
+        throw std::runtime_error("setsockopt()");
+    }
+#endif
+
+    auto socket = std::make_unique<Socket>();
+    socket->fd = fd;
+    socket->address = host_;
+    socket->path = abstract ? std::string{} : name;
+    socket->local = true;
+    socket_guard.dismiss();
+
+    const std::scoped_lock lock{sockets_mutex_};
+    sockets_.push_back(std::move(socket));
+}
+
+Listener::Socket * Listener::find_socket(const int fd)
+{
+    for (const auto & socket : sockets_)
+    {
+        if (socket->watched_fd() == fd)
+        {
+            return socket.get();
+        }
+    }
+
+    return nullptr;
+}
+
+void Listener::on_readable(const int fd)
+{
+    Socket * const socket = find_socket(fd);
+
+    if (socket == nullptr)
+    {
+        return;
+    }
+
+    const std::size_t packet_count = socket->receive(*batch_);
+
+    if (packet_count != 0)
+    {
+        socket->packets.fetch_add(packet_count, std::memory_order_relaxed);
+        socket->batches.fetch_add(1, std::memory_order_relaxed);
+    }
+    const std::uint64_t received_us = protocol::now_us();
+    const auto received_at = std::chrono::steady_clock::now();
+
+    const auto peer_state = std::atomic_load(&peer_state_);
+
+    // Only the newest layout of a burst matters; applying the earlier ones would just flash stale
+    // layouts on screen and cost an X round-trip each.
+    std::optional<protocol::Message> latest;
+    std::size_t accepted = 0;
+
+    for (std::size_t i = 0; i < packet_count; ++i)
+    {
+        if (socket->local && !trusted_sender(*batch_, i))
+        {
+            rejected_packets_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const auto message = protocol::parse(batch_->buffers[i].data(), batch_->sizes[i]);
+
+        if (!message)
+        {
+            parse_failures_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (message->type != protocol::MessageType::Layout)
         {
-            break;
+            continue;
         }
 
-        if ((poll_fd.revents & POLLIN) == 0)
+        // Multicast loops our own packets back; acking one would settle a destination that no peer
+        // has acked.
+        if (peer_state && !message->legacy && message->origin == peer_state->origin())
         {
             continue;
         }
 
-        struct sockaddr sender = {0};
-        socklen_t sender_size = sizeof(sender);
+        // Duplicates are acked too: the previous ack may be the one that got lost.
+        if ((message->flags & protocol::flag_ack_requested) != 0)
+        {
+            send_ack(socket->fd, *message, batch_->senders[i], batch_->sender_sizes[i]);
+        }
 
-        const int packet_size = ::recvfrom(
-            poll_fd.fd,
-            buffer.data(),
-            buffer.size(),
-            0,
-            &sender,
-            &sender_size);
+        if (!message->legacy && !accept_sequence(last_sequences_, *message))
+        {
+            stale_packets_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
 
-        if (packet_size < 0)
+        // Checked packet by packet, so that a stale update later in the batch cannot displace a
+        // newer one that came first.
+        if (peer_state && !peer_state->on_remote_change(*message))
         {
-            throw std::runtime_error("recvfrom()");
+            continue;
         }
 
-        if (on_layout_received_)
+        // Updates from different origins may arrive out of order; legacy packets carry no version
+        // and the last one wins.
+        if (!latest
+            || latest->legacy
+            || message->legacy
+            || std::tie(message->timestamp_us, message->origin)
+                > std::tie(latest->timestamp_us, latest->origin))
         {
-            static std::regex word{R"(\w+)"};
-            std::string data_str(buffer.data(), buffer.size());
-            std::smatch result;
-            if (std::regex_search(data_str, result, word))
-            {
-                on_layout_received_(result.str(0));
-            }
+            latest = message;
         }
+
+        ++accepted;
+    }
+
+    if (!latest)
+    {
+        return;
+    }
+
+    coalesced_packets_.fetch_add(accepted - 1, std::memory_order_relaxed);
+
+    if (latency_tracer_ && (latest->flags & protocol::flag_capture_timestamp) != 0)
+    {
+        // Clocks of different hosts may disagree; a capture time in the future counts as 0.
+        latency_tracer_->record(
+            LatencyStage::Network,
+            received_us > latest->timestamp_us ? (received_us - latest->timestamp_us) * 1000 : 0);
+        latency_tracer_->record(
+            LatencyStage::Parse,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - received_at).count());
     }
+
+    on_layout_received_(*latest);
+}
+
+void Listener::set_peer_state(std::shared_ptr<PeerState> peer_state)
+{
+    std::atomic_store(&peer_state_, std::move(peer_state));
 }
 
+std::uint64_t Listener::coalesced_packets() const
+{
+    return coalesced_packets_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Listener::stale_packets() const
+{
+    return stale_packets_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Listener::rejected_packets() const
+{
+    return rejected_packets_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Listener::parse_failures() const
+{
+    return parse_failures_.load(std::memory_order_relaxed);
+}
@@ -1,25 +1,123 @@
 #pragma once
 
-#include "worker.h"
+#include "config.h"
+#include "latency.h"
+#include "peer_state.h"
+#include "protocol.h"
+#include "reactor.h"
+#include "receive_batch.h"
+#include "transport.h"
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-using OnLayoutReceived = std::function<void(std::string)>;
+#include <netdb.h>
 
-class Listener : public Worker
+#if HAS_IO_URING
+class UringReceiver;
+#endif
+
+using OnLayoutReceived = std::function<void(const protocol::Message &)>;
+
+struct ListenerSocketStats
+{
+    // Numeric address and port the socket is bound to.
+    std::string address;
+    std::uint64_t packets = 0;
+    // Wakeups that received at least one packet.
+    std::uint64_t batches = 0;
+    // Syscalls spent receiving: recvmmsg() or, with io_uring, io_uring_enter().
+    std::uint64_t receive_syscalls = 0;
+    ReceiveBackend backend = ReceiveBackend::Socket;
+};
+
+// Receives layout updates on a UDP socket for every address the host resolves to, e.g. both the
+// IPv4 and the IPv6 wildcard if the host is empty, or on an AF_UNIX datagram socket for a "unix:"
+// host; runs as a Reactor handler. Over AF_UNIX only root and the user the listener runs as may send
+// updates.
+class Listener : public EventHandler
 {
 public:
     Listener(
         const std::string & host,
         const std::string & port,
-        OnLayoutReceived on_layout_received);
+        const TransportOptions & transport,
+        OnLayoutReceived on_layout_received,
+        std::shared_ptr<LatencyTracer> latency_tracer = nullptr,
+        ReceiveBackend receive_backend = ReceiveBackend::Socket);
+    ~Listener() override;
+
+    // Packets that were superseded by a newer one from the same receive batch and never applied.
+    std::uint64_t coalesced_packets() const;
+    // Duplicate or out-of-order packets that were dropped.
+    std::uint64_t stale_packets() const;
+    // Packets on an AF_UNIX socket from other users.
+    std::uint64_t rejected_packets() const;
+    // Packets that were not valid protocol messages.
+    std::uint64_t parse_failures() const;
+    std::vector<ListenerSocketStats> socket_stats() const;
+
+    // In peer mode, every received update is checked against the peer state before the updates of
+    // a batch are merged, and our own packets are neither applied nor acked. Null leaves peer mode.
+    void set_peer_state(std::shared_ptr<PeerState> peer_state);
+
+    std::vector<int> open() override;
+    void close() override;
+    void on_readable(int fd) override;
+
+private:
+    struct Socket
+    {
+        Socket();
+        ~Socket();
+
+        // The fd the reactor watches: the socket or its io_uring.
+        int watched_fd() const;
+        std::size_t receive(ReceiveBatch & batch);
+
+        int fd = -1;
+        std::string address;
+        // Socket file to remove on close; empty for IP and abstract sockets.
+        std::string path;
+        // AF_UNIX: senders are checked against their credentials.
+        bool local = false;
+#if HAS_IO_URING
+        // Null unless receiving through io_uring.
+        std::unique_ptr<UringReceiver> uring;
+#endif
+        std::atomic<std::uint64_t> packets{0};
+        std::atomic<std::uint64_t> batches{0};
+        std::atomic<std::uint64_t> receive_syscalls{0};
+    };
 
-protected:
-    void run() override;
+    void open_socket(const struct addrinfo & address_info);
+    void open_unix_socket(const std::string & name);
+    Socket * find_socket(int fd);
 
 private:
     const std::string host_;
     const std::string port_;
+    const TransportOptions transport_;
     const OnLayoutReceived on_layout_received_;
+    // Records the network and parse stages of traced packets; may be null.
+    const std::shared_ptr<LatencyTracer> latency_tracer_;
+    const ReceiveBackend receive_backend_;
+    const std::unique_ptr<ReceiveBatch> batch_;
+    // Set from the controlling thread, read on the reactor thread.
+    std::shared_ptr<PeerState> peer_state_;
+    // Changed only by open() and close() on the reactor thread; the mutex guards readers on other
+    // threads.
+    std::vector<std::unique_ptr<Socket>> sockets_;
+    mutable std::mutex sockets_mutex_;
+    std::unordered_map<std::uint32_t, std::uint32_t> last_sequences_;
+    std::atomic<std::uint64_t> coalesced_packets_{0};
+    std::atomic<std::uint64_t> stale_packets_{0};
+    std::atomic<std::uint64_t> rejected_packets_{0};
+    std::atomic<std::uint64_t> parse_failures_{0};
 };
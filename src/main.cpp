@@ -1,21 +1,13 @@
 // vi: ts=4 sw=4 tw=100 et
 
 #include "config.h"
+#include "service.h"
 #include "settings.h"
 #include "settings_window.h"
-#include "status.h"
-#include "worker.h"
-#include "xkb_switch_lib.h"
-#include "listener.h"
 
-#if HAS_X11
-#include "sender.h"
-#endif
-
-#include <memory>
-#include <string>
 #include <iostream>
-#include <mutex>
+#include <string>
+#include <utility>
 
 #include <QAction>
 #include <QApplication>
@@ -29,24 +21,15 @@ public:
     template<typename... Args>
     Application(Args &&... args);
 
-    ~Application();
-
     int exec();
 
 private:
     QIcon make_icon() const;
-    std::unique_ptr<Listener> make_listener(const Settings & settings);
 
-    void start_listener();
-    void stop();
     void quit();
     void show_settings();
-    void apply_settings(const Settings & settings);
-
-#if HAS_X11
-    std::unique_ptr<Sender> make_sender(const Settings & settings);
-    void start_sender();
-#endif
+    void update_tooltip();
+    void dump_latency();
 
 private:
     QApplication qapplication_;
@@ -54,15 +37,13 @@ private:
     QAction * const stop_action_;
     QAction * const settings_action_;
     QAction * const quit_action_;
+    QAction * const dump_latency_action_;
     QSystemTrayIcon systray_icon_{make_icon()};
-
-    std::mutex mutex_;
-    Settings settings_;
-    std::unique_ptr<Listener> listener_;
+    Service service_;
 
 #if HAS_X11
     QAction * const start_sender_action_;
-    std::unique_ptr<Sender> sender_;
+    QAction * const start_peer_action_;
 #endif
 };
 
@@ -73,21 +54,23 @@ Application::Application(Args &&... args)
     , stop_action_{new QAction("S&top", &qapplication_)}
     , settings_action_{new QAction("&Settings", &qapplication_)}
     , quit_action_{new QAction("&Quit", &qapplication_)}
-    , settings_{load_settings()}
-    , listener_{make_listener(settings_)}
+    , dump_latency_action_{new QAction("&Dump latency", &qapplication_)}
+    , service_{load_settings()}
 #if HAS_X11
     , start_sender_action_{new QAction("Start &transmitter", &qapplication_)}
-    , sender_{make_sender(settings_)}
+    , start_peer_action_{new QAction("Start &peer", &qapplication_)}
 #endif
 {
     qapplication_.setQuitOnLastWindowClosed(false);
-    qapplication_.connect(start_listener_action_, &QAction::triggered, [this] { start_listener(); });
-    qapplication_.connect(stop_action_, &QAction::triggered, [this] { stop(); });
+    qapplication_.connect(start_listener_action_, &QAction::triggered, [this] { service_.start_listener(); });
+    qapplication_.connect(stop_action_, &QAction::triggered, [this] { service_.stop(); });
     qapplication_.connect(settings_action_, &QAction::triggered, [this] { show_settings(); });
     qapplication_.connect(quit_action_, &QAction::triggered, [this] { quit(); });
+    qapplication_.connect(dump_latency_action_, &QAction::triggered, [this] { dump_latency(); });
 
 #if HAS_X11
-    qapplication_.connect(start_sender_action_, &QAction::triggered, [this] { start_sender(); });
+    qapplication_.connect(start_sender_action_, &QAction::triggered, [this] { service_.start_sender(); });
+    qapplication_.connect(start_peer_action_, &QAction::triggered, [this] { service_.start_peer(); });
 #endif
 
     const auto menu = new QMenu();
@@ -95,23 +78,25 @@ Application::Application(Args &&... args)
 
 #if HAS_X11
     menu->addAction(start_sender_action_);
+    menu->addAction(start_peer_action_);
 #endif
 
     menu->addAction(stop_action_);
     menu->addAction(quit_action_);
     menu->addAction(settings_action_);
+    menu->addAction(dump_latency_action_);
+
+    // Refreshed on demand rather than by a timer, which would wake the GUI thread for nothing while
+    // the icon is left alone.
+    qapplication_.connect(menu, &QMenu::aboutToShow, [this] { update_tooltip(); });
+    qapplication_.connect(
+        &systray_icon_,
+        &QSystemTrayIcon::activated,
+        [this] { update_tooltip(); });
 
     systray_icon_.setContextMenu(menu);
     systray_icon_.show();
-}
-
-Application::~Application()
-{
-    const std::scoped_lock lock{mutex_};
-    listener_->stop();
-#if HAS_X11
-    sender_->stop();
-#endif
+    update_tooltip();
 }
 
 int Application::exec()
@@ -130,42 +115,9 @@ QIcon Application::make_icon() const
     return icon;
 }
 
-std::unique_ptr<Listener> Application::make_listener(const Settings & settings)
-{
-    return std::make_unique<Listener>(
-        settings_.receiver_host,
-        settings_.receiver_port,
-        [lib = std::make_shared<XkbSwitchLib>(settings.xkbswitchlib_path)](const std::string layout)
-        {
-            lib->set_layout(layout);
-        });
-}
-
-void Application::start_listener()
-{
-    const std::scoped_lock lock{mutex_};
-    listener_->start();
-}
-
-void Application::stop()
-{
-    const std::scoped_lock lock{mutex_};
-    listener_->stop();
-#if HAS_X11
-    sender_->stop();
-#endif
-}
-
 void Application::quit()
 {
-    {
-        const std::scoped_lock lock{mutex_};
-        listener_->stop();
-#if HAS_X11
-        sender_->stop();
-#endif
-    }
-
+    service_.stop();
     qapplication_.quit();
 }
 
@@ -174,7 +126,7 @@ void Application::show_settings()
     SettingsWindow * const settings_window = new SettingsWindow(
         [this](const Settings & settings)
         {
-            apply_settings(settings);
+            service_.apply_settings(settings);
         });
 
     settings_window->show();
@@ -182,50 +134,18 @@ void Application::show_settings()
     settings_window->activateWindow();
 }
 
-void Application::apply_settings(const Settings & settings)
-{
-    const std::scoped_lock lock{mutex_};
-    const bool is_listener_running = listener_->status() == Status::Running;
-
-#if HAS_X11
-    const bool is_sender_running = sender_->status() == Status::Running;
-    sender_->stop();
-#endif
-
-    settings_ = settings;
-    listener_->stop();
-
-    listener_ = make_listener(settings_);
-    if (is_listener_running)
-    {
-        listener_->start();
-    }
-
-#if HAS_X11
-    sender_ = make_sender(settings_);
-    if (is_sender_running)
-    {
-        sender_->start();
-    }
-#endif
-}
-
-#if HAS_X11
-std::unique_ptr<Sender> Application::make_sender(const Settings & settings)
+void Application::update_tooltip()
 {
-    return std::make_unique<Sender>(
-        settings_.receiver_host,
-        settings_.receiver_port,
-        settings_.keyboard_groups);
+    const std::string report = service_.latency_report();
+    systray_icon_.setToolTip(QString::fromStdString(
+        report.empty() ? "kbd-layout-sync" : "kbd-layout-sync\n" + report));
 }
 
-void Application::start_sender()
+void Application::dump_latency()
 {
-    const std::scoped_lock lock{mutex_};
-    listener_->stop();
-    sender_->start();
+    const std::string report = service_.latency_report();
+    std::cout << (report.empty() ? "No traced layout updates" : report) << std::endl;
 }
-#endif
 
 int main(int argc, char * argv[])
 {
@@ -0,0 +1,372 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "metrics.h"
+#include "endpoint.h"
+#include "transport.h"
+
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <QScopeGuard>
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr std::size_t max_request_size = 4096;
+
+std::string format_value(const double value)
+{
+    if (std::isnan(value))
+    {
+        return "NaN";
+    }
+
+    if (std::isinf(value))
+    {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+
+    std::ostringstream stream;
+    stream.precision(17);
+    stream << value;
+    return stream.str();
+}
+
+void append_label_value(std::string & text, const std::string & value)
+{
+    for (const char c : value)
+    {
+        switch (c)
+        {
+        case '\\':
+            text += "\\\\";
+            break;
+        case '"':
+            text += "\\\"";
+            break;
+        case '\n':
+            text += "\\n";
+            break;
+        default:
+            text += c;
+        }
+    }
+}
+
+bool send_all(const int fd, const std::string & data)
+{
+    std::size_t sent = 0;
+
+    while (sent < data.size())
+    {
+        const ssize_t result = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (result <= 0)
+        {
+            return false;
+        }
+
+        sent += result;
+    }
+
+    return true;
+}
+
+std::string response(const std::string & status, const std::string & body)
+{
+    return "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n"
+        "\r\n" + body;
+}
+
+}
+
+void MetricsWriter::counter(
+    const std::string_view name,
+    const std::string_view help,
+    const double value,
+    const MetricLabels & labels)
+{
+    header(name, help, "counter");
+    sample(name, {}, value, labels);
+}
+
+void MetricsWriter::gauge(
+    const std::string_view name,
+    const std::string_view help,
+    const double value,
+    const MetricLabels & labels)
+{
+    header(name, help, "gauge");
+    sample(name, {}, value, labels);
+}
+
+void MetricsWriter::summary(
+    const std::string_view name,
+    const std::string_view help,
+    const double sum,
+    const std::uint64_t count,
+    const MetricLabels & labels)
+{
+    header(name, help, "summary");
+    sample(name, "_sum", sum, labels);
+    sample(name, "_count", static_cast<double>(count), labels);
+}
+
+const std::string & MetricsWriter::text() const
+{
+    return text_;
+}
+
+void MetricsWriter::header(
+    const std::string_view name,
+    const std::string_view help,
+    const std::string_view type)
+{
+    if (name == last_name_)
+    {
+        return;
+    }
+
+    last_name_ = name;
+    text_.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    text_.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void MetricsWriter::sample(
+    const std::string_view name,
+    const std::string_view suffix,
+    const double value,
+    const MetricLabels & labels)
+{
+    text_.append(name).append(suffix);
+
+    if (!labels.empty())
+    {
+        text_ += '{';
+
+        for (std::size_t i = 0; i < labels.size(); ++i)
+        {
+            if (i > 0)
+            {
+                text_ += ',';
+            }
+
+            text_.append(labels[i].first).append("=\"");
+            append_label_value(text_, labels[i].second);
+            text_ += '"';
+        }
+
+        text_ += '}';
+    }
+
+    text_.append(" ").append(format_value(value)).append("\n");
+}
+
+MetricsServer::MetricsServer(const std::string & address, CollectMetrics collect)
+    : address_{address}
+    , collect_{std::move(collect)}
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+void MetricsServer::run()
+{
+    const int listen_fd = open_socket();
+
+    const auto socket_guard = qScopeGuard([&]
+    {
+        ::close(listen_fd);
+
+        if (!path_.empty())
+        {
+            ::unlink(path_.c_str());
+        }
+    });
+
+    struct pollfd poll_fds[] = {
+        {wakeup_fd(), POLLIN, 0},
+        {listen_fd, POLLIN, 0}};
+
+    while (!should_stop())
+    {
+        if (::poll(poll_fds, std::size(poll_fds), -1) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll()");
+        }
+
+        if ((poll_fds[1].revents & POLLIN) == 0)
+        {
+            continue;
+        }
+
+        const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        const auto client_guard = qScopeGuard([&]
+        {
+            ::close(fd);
+        });
+
+        serve(fd);
+    }
+}
+
+int MetricsServer::open_socket()
+{
+    path_.clear();
+
+    if (is_unix_host(address_))
+    {
+        const std::string name = unix_socket_name(address_);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (fd < 0)
+        {
+            throw std::runtime_error("socket()");
+        }
+
+        auto socket_guard = qScopeGuard([&]
+        {
+            ::close(fd);
+        });
+
+        bind_unix_socket(fd, name);
+
+        if (name.front() != '@')
+        {
+            path_ = name;
+            ::chmod(name.c_str(), S_IRUSR | S_IWUSR);
+        }
+
+        if (::listen(fd, SOMAXCONN) != 0)
+        {
+            throw std::runtime_error("listen()");
+        }
+
+        socket_guard.dismiss();
+        return fd;
+    }
+
+    const auto endpoint = parse_endpoint(address_);
+
+    if (!endpoint || endpoint->port.empty())
+    {
+        throw std::runtime_error("invalid metrics address " + address_);
+    }
+
+    struct addrinfo hints = {};
+    struct addrinfo * server_info = nullptr;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    const char * const host = endpoint->host.empty() ? nullptr : endpoint->host.c_str();
+
+    if (::getaddrinfo(host, endpoint->port.c_str(), &hints, &server_info) != 0)
+    {
+        throw std::runtime_error("getaddrinfo()");
+    }
+
+    const auto server_info_guard = qScopeGuard([&]
+    {
+        ::freeaddrinfo(server_info);
+    });
+
+    for (const struct addrinfo * address_info = server_info;
+        address_info != nullptr;
+        address_info = address_info->ai_next)
+    {
+        const int fd = ::socket(
+            address_info->ai_family,
+            address_info->ai_socktype | SOCK_CLOEXEC,
+            address_info->ai_protocol);
+
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        int sockopt = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &sockopt, sizeof(sockopt));
+
+        if (::bind(fd, address_info->ai_addr, address_info->ai_addrlen) == 0
+            && ::listen(fd, SOMAXCONN) == 0)
+        {
+            return fd;
+        }
+
+        ::close(fd);
+    }
+
+    throw std::runtime_error("cannot listen for metrics on " + address_);
+}
+
+void MetricsServer::serve(const int fd)
+{
+    // A scraper that stalls must not keep the server from stopping for long.
+    struct timeval timeout = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    std::array<char, 1024> buffer;
+
+    // Only the request line matters; the headers are read so that closing the connection does not
+    // reset it before the client has seen the response.
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < max_request_size)
+    {
+        const ssize_t size = ::recv(fd, buffer.data(), buffer.size(), 0);
+
+        if (size < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (size <= 0)
+        {
+            return;
+        }
+
+        request.append(buffer.data(), size);
+    }
+
+    const std::string request_line = request.substr(0, request.find("\r\n"));
+
+    if (request_line.rfind("GET /metrics ", 0) != 0 && request_line.rfind("GET / ", 0) != 0)
+    {
+        send_all(fd, response("404 Not Found", "Not found\n"));
+        return;
+    }
+
+    MetricsWriter writer;
+    collect_(writer);
+    send_all(fd, response("200 OK", writer.text()));
+}
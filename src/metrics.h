@@ -0,0 +1,77 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "worker.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using MetricLabels = std::vector<std::pair<std::string_view, std::string>>;
+
+// Formats metrics in the Prometheus text exposition format. Samples of one metric must be written
+// one after another; the HELP and TYPE lines are written before the first of them.
+class MetricsWriter
+{
+public:
+    void counter(
+        std::string_view name,
+        std::string_view help,
+        double value,
+        const MetricLabels & labels = {});
+    void gauge(
+        std::string_view name,
+        std::string_view help,
+        double value,
+        const MetricLabels & labels = {});
+    // A summary without quantiles: the _sum and _count samples.
+    void summary(
+        std::string_view name,
+        std::string_view help,
+        double sum,
+        std::uint64_t count,
+        const MetricLabels & labels = {});
+
+    const std::string & text() const;
+
+private:
+    void header(std::string_view name, std::string_view help, std::string_view type);
+    void sample(
+        std::string_view name,
+        std::string_view suffix,
+        double value,
+        const MetricLabels & labels);
+
+private:
+    std::string text_;
+    std::string last_name_;
+};
+
+using CollectMetrics = std::function<void(MetricsWriter &)>;
+
+// Serves metrics over HTTP for Prometheus to scrape, on "host:port" or a "unix:" socket. Runs on
+// its own thread and answers one request at a time, so a slow scraper never delays layout updates;
+// collect is called from that thread for every request.
+class MetricsServer : public Worker
+{
+public:
+    MetricsServer(const std::string & address, CollectMetrics collect);
+    ~MetricsServer() override;
+
+protected:
+    void run() override;
+
+private:
+    int open_socket();
+    void serve(int fd);
+
+private:
+    const std::string address_;
+    // Socket file to remove on exit; empty unless serving on a unix path.
+    std::string path_;
+    const CollectMetrics collect_;
+};
@@ -0,0 +1,86 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "peer_state.h"
+
+#include <algorithm>
+#include <tuple>
+
+PeerState::PeerState()
+    : origin_{protocol::random_origin()}
+{
+}
+
+std::uint32_t PeerState::origin() const
+{
+    return origin_;
+}
+
+std::optional<std::uint64_t> PeerState::on_local_change(
+    const std::string_view layout,
+    const std::uint64_t timestamp_us)
+{
+    const std::scoped_lock lock{mutex_};
+
+    if (is_current(layout))
+    {
+        suppressed_echoes_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    const std::uint64_t version_timestamp_us = std::max(timestamp_us, timestamp_us_ + 1);
+    set_current(layout, version_timestamp_us, origin_);
+    return version_timestamp_us;
+}
+
+bool PeerState::on_remote_change(const protocol::Message & message)
+{
+    const std::scoped_lock lock{mutex_};
+
+    // Legacy packets carry no version; they come from one-way transmitters and always apply.
+    if (message.legacy)
+    {
+        set_current(message.layout, timestamp_us_, version_origin_);
+        return true;
+    }
+
+    if (message.origin == origin_
+        || std::tie(message.timestamp_us, message.origin) <= std::tie(timestamp_us_, version_origin_))
+    {
+        // Heartbeats repeat the version a peer already has as a matter of course.
+        if ((message.flags & protocol::flag_heartbeat) == 0)
+        {
+            rejected_updates_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return false;
+    }
+
+    set_current(message.layout, message.timestamp_us, message.origin);
+    return true;
+}
+
+std::uint64_t PeerState::suppressed_echoes() const
+{
+    return suppressed_echoes_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t PeerState::rejected_updates() const
+{
+    return rejected_updates_.load(std::memory_order_relaxed);
+}
+
+bool PeerState::is_current(const std::string_view layout) const
+{
+    return layout_size_ != 0 && std::string_view(layout_.data(), layout_size_) == layout;
+}
+
+void PeerState::set_current(
+    const std::string_view layout,
+    const std::uint64_t timestamp_us,
+    const std::uint32_t origin)
+{
+    layout_size_ = std::min(layout.size(), layout_.size());
+    std::copy_n(layout.cbegin(), layout_size_, layout_.begin());
+    timestamp_us_ = timestamp_us;
+    version_origin_ = origin;
+}
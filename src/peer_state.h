@@ -0,0 +1,55 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "protocol.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+// The layout all peers agree on in peer mode, where every host both sends and receives.
+//
+// Each change is versioned by (timestamp, origin), so every peer orders concurrent changes the
+// same way and the newest one wins everywhere. Local changes are stamped past the newest version
+// seen, which keeps clock skew between peers from making a host's changes lose forever.
+//
+// Applying a received layout makes the local X server report a group change, which the sender
+// would send straight back. Such echoes are recognized because their layout already is the agreed
+// one, so after a change exactly one packet per receiver goes out, from the host that made it.
+class PeerState
+{
+public:
+    PeerState();
+
+    // Origin to send local changes with, see protocol::Message::origin.
+    std::uint32_t origin() const;
+
+    // Called for a local group change mapped to layout. Returns the timestamp to send it with, or
+    // std::nullopt if the layout already is the agreed one and nothing needs to be sent.
+    std::optional<std::uint64_t> on_local_change(std::string_view layout, std::uint64_t timestamp_us);
+
+    // Called for a received update. Returns false for our own packets and for updates older than
+    // the agreed layout, which must not be applied.
+    bool on_remote_change(const protocol::Message & message);
+
+    std::uint64_t suppressed_echoes() const;
+    std::uint64_t rejected_updates() const;
+
+private:
+    bool is_current(std::string_view layout) const;
+    void set_current(std::string_view layout, std::uint64_t timestamp_us, std::uint32_t origin);
+
+private:
+    const std::uint32_t origin_;
+    std::mutex mutex_;
+    std::array<char, protocol::max_layout_size> layout_;
+    std::size_t layout_size_ = 0;
+    std::uint64_t timestamp_us_ = 0;
+    std::uint32_t version_origin_ = 0;
+    std::atomic<std::uint64_t> suppressed_echoes_{0};
+    std::atomic<std::uint64_t> rejected_updates_{0};
+};
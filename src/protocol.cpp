@@ -0,0 +1,151 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "protocol.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+namespace protocol
+{
+
+namespace
+{
+
+template <typename T>
+T load_be(const char * const data)
+{
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+    {
+        value = (value << 8) | static_cast<unsigned char>(data[i]);
+    }
+    return value;
+}
+
+template <typename T>
+void store_be(char * const data, const T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+    {
+        data[i] = static_cast<char>((value >> (8 * (sizeof(T) - 1 - i))) & 0xff);
+    }
+}
+
+bool is_word_char(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+std::optional<Message> parse_legacy(const char * const data, const std::size_t size)
+{
+    const char * const end = data + size;
+    const char * begin = data;
+
+    while (begin != end && !is_word_char(*begin))
+    {
+        ++begin;
+    }
+
+    const char * word_end = begin;
+
+    while (word_end != end && is_word_char(*word_end))
+    {
+        ++word_end;
+    }
+
+    if (begin == word_end)
+    {
+        return std::nullopt;
+    }
+
+    Message message;
+    message.layout = std::string_view(begin, word_end - begin);
+    message.legacy = true;
+    return message;
+}
+
+}
+
+std::optional<Message> parse(const char * const data, const std::size_t size)
+{
+    if (size < sizeof(magic) || load_be<std::uint32_t>(data) != magic)
+    {
+        return parse_legacy(data, size);
+    }
+
+    if (size < header_size || static_cast<std::uint8_t>(data[4]) != version)
+    {
+        return std::nullopt;
+    }
+
+    const std::size_t layout_size = static_cast<unsigned char>(data[7]);
+
+    if (size < header_size + layout_size)
+    {
+        return std::nullopt;
+    }
+
+    Message message;
+    message.type = static_cast<MessageType>(data[5]);
+    message.flags = static_cast<std::uint8_t>(data[6]);
+    message.origin = load_be<std::uint32_t>(data + 8);
+    message.sequence = load_be<std::uint32_t>(data + 12);
+    message.timestamp_us = load_be<std::uint64_t>(data + 16);
+    message.layout = std::string_view(data + header_size, layout_size);
+
+    if (message.type != MessageType::Layout && message.type != MessageType::Ack)
+    {
+        return std::nullopt;
+    }
+
+    return message;
+}
+
+std::size_t encode(const Message & message, char * const buffer, const std::size_t size)
+{
+    const std::size_t packet_size = header_size + message.layout.size();
+
+    if (message.layout.size() > max_layout_size || packet_size > size)
+    {
+        return 0;
+    }
+
+    store_be(buffer, magic);
+    buffer[4] = static_cast<char>(version);
+    buffer[5] = static_cast<char>(message.type);
+    buffer[6] = static_cast<char>(message.flags);
+    buffer[7] = static_cast<char>(message.layout.size());
+    store_be(buffer + 8, message.origin);
+    store_be(buffer + 12, message.sequence);
+    store_be(buffer + 16, message.timestamp_us);
+    std::memcpy(buffer + header_size, message.layout.data(), message.layout.size());
+
+    return packet_size;
+}
+
+void stamp(
+    char * const packet,
+    const std::uint8_t flags,
+    const std::uint32_t origin,
+    const std::uint32_t sequence,
+    const std::uint64_t timestamp_us)
+{
+    packet[6] = static_cast<char>(flags);
+    store_be(packet + 8, origin);
+    store_be(packet + 12, sequence);
+    store_be(packet + 16, timestamp_us);
+}
+
+std::uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::uint32_t random_origin()
+{
+    return std::random_device{}();
+}
+
+}
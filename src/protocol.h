@@ -0,0 +1,84 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Wire format of layout updates. All integers are big-endian.
+//
+//   offset  size  field
+//        0     4  magic ("KBLS")
+//        4     1  version
+//        5     1  message type
+//        6     1  flags
+//        7     1  layout name length
+//        8     4  origin (random per sender instance)
+//       12     4  sequence number
+//       16     8  timestamp, microseconds since the Unix epoch
+//       24     n  layout name, not NUL-terminated
+//
+// Acks carry no layout name.
+//
+// Packets that do not start with the magic are treated as legacy plain-text packets: the first
+// run of word characters is taken as the layout name.
+namespace protocol
+{
+
+constexpr std::uint32_t magic = 0x4b424c53;
+constexpr std::uint8_t version = 1;
+constexpr std::size_t header_size = 24;
+constexpr std::size_t max_layout_size = 255;
+constexpr std::size_t max_packet_size = header_size + max_layout_size;
+
+enum class MessageType : std::uint8_t
+{
+    Layout = 1,
+    // Acknowledges the layout message with the same origin and sequence number.
+    Ack = 2,
+};
+
+// Message flags.
+constexpr std::uint8_t flag_ack_requested = 0x01;
+// timestamp_us is when the change was captured on the sender, for latency tracing.
+constexpr std::uint8_t flag_capture_timestamp = 0x02;
+// Repeats the newest layout, with its original timestamp, while nothing changes; receivers check
+// their state against it instead of applying it blindly.
+constexpr std::uint8_t flag_heartbeat = 0x04;
+
+struct Message
+{
+    MessageType type = MessageType::Layout;
+    std::uint8_t flags = 0;
+    std::uint32_t origin = 0;
+    std::uint32_t sequence = 0;
+    std::uint64_t timestamp_us = 0;
+    // Points into the buffer passed to parse().
+    std::string_view layout;
+    bool legacy = false;
+};
+
+// Parses a received datagram without allocating. Returns std::nullopt for malformed packets and
+// packets of an unsupported version.
+std::optional<Message> parse(const char * data, std::size_t size);
+
+// Encodes a message into buffer. Returns the packet size, or 0 if it does not fit.
+std::size_t encode(const Message & message, char * buffer, std::size_t size);
+
+// Rewrites the per-packet header fields of an encoded packet in place, so that the rest of it can
+// be encoded once and reused.
+void stamp(
+    char * packet,
+    std::uint8_t flags,
+    std::uint32_t origin,
+    std::uint32_t sequence,
+    std::uint64_t timestamp_us);
+
+std::uint64_t now_us();
+
+// A random origin for a new sender instance.
+std::uint32_t random_origin();
+
+}
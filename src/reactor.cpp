@@ -0,0 +1,438 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "reactor.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include <QScopeGuard>
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+namespace
+{
+
+constexpr std::size_t max_events = 16;
+
+void log_error(const std::exception & e)
+{
+    std::cerr << "Error: " << e.what() << std::endl;
+}
+
+}
+
+int EventHandler::prepare()
+{
+    return -1;
+}
+
+void EventHandler::on_timeout()
+{
+}
+
+Reactor::Reactor()
+{
+#ifdef __linux__
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+
+    if (epoll_fd_ < 0)
+    {
+        throw std::runtime_error("epoll_create1()");
+    }
+#endif
+
+    watch(command_wakeup_.fd());
+    watch(wakeup_fd());
+}
+
+Reactor::~Reactor()
+{
+    // Handlers added while the reactor never ran are still open.
+    while (!registrations_.empty())
+    {
+        close_handler(registrations_.begin());
+    }
+
+    if (epoll_fd_ >= 0)
+    {
+        ::close(epoll_fd_);
+    }
+}
+
+bool Reactor::add(EventHandler & handler)
+{
+    bool added = false;
+
+    call([&]
+    {
+        const auto registration = std::find_if(
+            registrations_.cbegin(),
+            registrations_.cend(),
+            [&](const Registration & registration) { return registration.handler == &handler; });
+
+        if (registration != registrations_.cend())
+        {
+            added = true;
+            return;
+        }
+
+        std::vector<int> fds;
+
+        try
+        {
+            fds = handler.open();
+        }
+        catch (const std::exception & e)
+        {
+            log_error(e);
+            handler_failures_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        registrations_.push_back({&handler, fds, std::nullopt});
+
+        for (const int fd : fds)
+        {
+            watch(fd);
+        }
+
+        added = true;
+    });
+
+    return added;
+}
+
+void Reactor::remove(EventHandler & handler)
+{
+    call([&]
+    {
+        const auto registration = std::find_if(
+            registrations_.begin(),
+            registrations_.end(),
+            [&](const Registration & registration) { return registration.handler == &handler; });
+
+        if (registration != registrations_.end())
+        {
+            close_handler(registration);
+        }
+    });
+}
+
+bool Reactor::contains(const EventHandler & handler)
+{
+    bool found = false;
+
+    call([&]
+    {
+        found = std::any_of(
+            registrations_.cbegin(),
+            registrations_.cend(),
+            [&](const Registration & registration) { return registration.handler == &handler; });
+    });
+
+    return found;
+}
+
+std::uint64_t Reactor::handler_failures() const
+{
+    return handler_failures_.load(std::memory_order_relaxed);
+}
+
+void Reactor::call(const std::function<void()> & function)
+{
+    if (std::this_thread::get_id() == thread_.get_id())
+    {
+        function();
+        return;
+    }
+
+    std::unique_lock lock{commands_mutex_};
+
+    if (!accepting_commands_)
+    {
+        // The reactor thread is not running, so the lock is all the synchronization needed.
+        function();
+        return;
+    }
+
+    std::packaged_task<void()> task{function};
+    auto result = task.get_future();
+    commands_.push_back(std::move(task));
+    lock.unlock();
+
+    command_wakeup_.notify();
+    result.get();
+}
+
+void Reactor::run_commands()
+{
+    // Commands run under the lock so that they cannot overlap with ones run inline by call().
+    const std::scoped_lock lock{commands_mutex_};
+    run_queued_commands();
+}
+
+void Reactor::run_queued_commands()
+{
+    while (!commands_.empty())
+    {
+        std::packaged_task<void()> task = std::move(commands_.front());
+        commands_.pop_front();
+        task();
+    }
+}
+
+void Reactor::watch(const int fd)
+{
+#ifdef __linux__
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        throw std::runtime_error("epoll_ctl()");
+    }
+#else
+    static_cast<void>(fd);
+#endif
+}
+
+void Reactor::unwatch(const int fd)
+{
+#ifdef __linux__
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+    static_cast<void>(fd);
+#endif
+}
+
+void Reactor::close_handler(const std::vector<Registration>::iterator registration)
+{
+    for (const int fd : registration->fds)
+    {
+        unwatch(fd);
+    }
+
+    EventHandler * const handler = registration->handler;
+    registrations_.erase(registration);
+
+    try
+    {
+        handler->close();
+    }
+    catch (const std::exception & e)
+    {
+        log_error(e);
+    }
+}
+
+int Reactor::prepare_handlers()
+{
+    std::optional<Clock::time_point> next_deadline;
+
+    for (std::size_t i = 0; i < registrations_.size();)
+    {
+        Registration & registration = registrations_[i];
+
+        try
+        {
+            const int timeout_ms = registration.handler->prepare();
+            registration.deadline.reset();
+
+            if (timeout_ms >= 0)
+            {
+                registration.deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+                if (!next_deadline || *registration.deadline < *next_deadline)
+                {
+                    next_deadline = registration.deadline;
+                }
+            }
+
+            ++i;
+        }
+        catch (const std::exception & e)
+        {
+            log_error(e);
+            handler_failures_.fetch_add(1, std::memory_order_relaxed);
+            close_handler(registrations_.begin() + i);
+        }
+    }
+
+    if (!next_deadline)
+    {
+        return -1;
+    }
+
+    const auto remaining = *next_deadline - Clock::now();
+
+    if (remaining <= Clock::duration::zero())
+    {
+        return 0;
+    }
+
+    // Rounded up, so that the wait does not end just before the deadline and spin.
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void Reactor::dispatch_readable(const int fd)
+{
+    const auto registration = std::find_if(
+        registrations_.begin(),
+        registrations_.end(),
+        [&](const Registration & registration)
+        {
+            return std::find(registration.fds.cbegin(), registration.fds.cend(), fd)
+                != registration.fds.cend();
+        });
+
+    // The handler may have been removed by an earlier event of the same wait.
+    if (registration == registrations_.end())
+    {
+        return;
+    }
+
+    try
+    {
+        registration->handler->on_readable(fd);
+    }
+    catch (const std::exception & e)
+    {
+        log_error(e);
+        handler_failures_.fetch_add(1, std::memory_order_relaxed);
+        close_handler(registration);
+    }
+}
+
+void Reactor::dispatch_timeouts()
+{
+    const auto now = Clock::now();
+
+    for (std::size_t i = 0; i < registrations_.size();)
+    {
+        Registration & registration = registrations_[i];
+
+        if (!registration.deadline || *registration.deadline > now)
+        {
+            ++i;
+            continue;
+        }
+
+        registration.deadline.reset();
+
+        try
+        {
+            registration.handler->on_timeout();
+            ++i;
+        }
+        catch (const std::exception & e)
+        {
+            log_error(e);
+            handler_failures_.fetch_add(1, std::memory_order_relaxed);
+            close_handler(registrations_.begin() + i);
+        }
+    }
+}
+
+void Reactor::run()
+{
+    {
+        const std::scoped_lock lock{commands_mutex_};
+        accepting_commands_ = true;
+    }
+
+    const auto guard = qScopeGuard([&]
+    {
+        const std::scoped_lock lock{commands_mutex_};
+        accepting_commands_ = false;
+        run_queued_commands();
+
+        while (!registrations_.empty())
+        {
+            close_handler(registrations_.begin());
+        }
+    });
+
+    while (true)
+    {
+        run_commands();
+
+        const int timeout_ms = prepare_handlers();
+
+#ifdef __linux__
+        std::array<struct epoll_event, max_events> events;
+        const int event_count = ::epoll_wait(epoll_fd_, events.data(), events.size(), timeout_ms);
+
+        if (event_count < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("epoll_wait()");
+        }
+
+        if (should_stop())
+        {
+            break;
+        }
+
+        for (int i = 0; i < event_count; ++i)
+        {
+            const int fd = events[i].data.fd;
+
+            if (fd == command_wakeup_.fd())
+            {
+                command_wakeup_.drain();
+            }
+            else if (fd != wakeup_fd())
+            {
+                dispatch_readable(fd);
+            }
+        }
+#else
+        std::vector<struct pollfd> poll_fds = {
+            {command_wakeup_.fd(), POLLIN, 0},
+            {wakeup_fd(), POLLIN, 0}};
+
+        for (const Registration & registration : registrations_)
+        {
+            for (const int fd : registration.fds)
+            {
+                poll_fds.push_back({fd, POLLIN, 0});
+            }
+        }
+
+        if (::poll(poll_fds.data(), poll_fds.size(), timeout_ms) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll()");
+        }
+
+        if (should_stop())
+        {
+            break;
+        }
+
+        if ((poll_fds[0].revents & POLLIN) != 0)
+        {
+            command_wakeup_.drain();
+        }
+
+        for (std::size_t i = 2; i < poll_fds.size(); ++i)
+        {
+            if ((poll_fds[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0)
+            {
+                dispatch_readable(poll_fds[i].fd);
+            }
+        }
+#endif
+
+        dispatch_timeouts();
+    }
+}
@@ -0,0 +1,89 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "wakeup.h"
+#include "worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Something driven by a Reactor. All callbacks run on the reactor thread; an exception thrown from
+// any of them is logged and removes the handler, like a failing Worker stops.
+class EventHandler
+{
+public:
+    virtual ~EventHandler() = default;
+
+    // Acquires the handler's resources and returns the fds to watch for readability.
+    virtual std::vector<int> open() = 0;
+    // Releases them again; called when the handler is removed or the reactor stops.
+    virtual void close() = 0;
+
+    virtual void on_readable(int fd) = 0;
+
+    // Called before every wait, e.g. to drain events a library has already buffered. Returns the
+    // milliseconds until on_timeout() is due, or -1 if no timer is needed.
+    virtual int prepare();
+    virtual void on_timeout();
+};
+
+// A single event loop thread that multiplexes the fds and timers of any number of handlers with
+// epoll, or poll() where epoll is not available. Handlers are added and removed from other threads
+// through a control pipe; both calls return once the reactor thread has carried them out.
+class Reactor : public Worker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Reactor();
+    ~Reactor() override;
+
+    // Opens the handler and starts watching its fds. Returns false if open() threw.
+    bool add(EventHandler & handler);
+    // Stops watching the handler and closes it; does nothing if it is not registered.
+    void remove(EventHandler & handler);
+    bool contains(const EventHandler & handler);
+
+    // Handlers that failed to open, or were removed because a callback threw.
+    std::uint64_t handler_failures() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Registration
+    {
+        EventHandler * handler;
+        std::vector<int> fds;
+        std::optional<Clock::time_point> deadline;
+    };
+
+    // Runs function on the reactor thread and waits for it; inline if the reactor is not running.
+    void call(const std::function<void()> & function);
+    void run_commands();
+    // commands_mutex_ must be held.
+    void run_queued_commands();
+    void watch(int fd);
+    void unwatch(int fd);
+    void close_handler(std::vector<Registration>::iterator registration);
+    int prepare_handlers();
+    void dispatch_readable(int fd);
+    void dispatch_timeouts();
+
+private:
+    int epoll_fd_ = -1;
+    std::vector<Registration> registrations_;
+    Wakeup command_wakeup_;
+    std::mutex commands_mutex_;
+    std::deque<std::packaged_task<void()>> commands_;
+    bool accepting_commands_ = false;
+    std::atomic<std::uint64_t> handler_failures_{0};
+};
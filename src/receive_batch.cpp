@@ -0,0 +1,108 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "receive_batch.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <errno.h>
+
+ReceiveBatch::ReceiveBatch()
+{
+#ifdef __linux__
+    for (std::size_t i = 0; i < capacity; ++i)
+    {
+        iovecs[i] = {buffers[i].data(), buffers[i].size()};
+        headers[i] = {};
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_name = &senders[i];
+        headers[i].msg_hdr.msg_control = controls[i].data();
+    }
+#endif
+}
+
+std::size_t ReceiveBatch::receive(const int fd)
+{
+#ifdef __linux__
+    for (auto & header : headers)
+    {
+        header.msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        header.msg_hdr.msg_controllen = controls.front().size();
+    }
+
+    const int count = ::recvmmsg(fd, headers.data(), capacity, MSG_DONTWAIT, nullptr);
+    ++syscalls;
+
+    if (count < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return 0;
+        }
+
+        throw std::runtime_error("recvmmsg()");
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        sizes[i] = headers[i].msg_len;
+        sender_sizes[i] = headers[i].msg_hdr.msg_namelen;
+    }
+
+    return count;
+#else
+    std::size_t count = 0;
+
+    for (; count < capacity; ++count)
+    {
+        socklen_t sender_size = sizeof(senders[count]);
+
+        const auto packet_size = ::recvfrom(
+            fd,
+            buffers[count].data(),
+            buffers[count].size(),
+            MSG_DONTWAIT,
+            reinterpret_cast<struct sockaddr *>(&senders[count]),
+            &sender_size);
+        ++syscalls;
+
+        if (packet_size < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                break;
+            }
+
+            throw std::runtime_error("recvfrom()");
+        }
+
+        sizes[count] = packet_size;
+        sender_sizes[count] = sender_size;
+    }
+
+    return count;
+#endif
+}
+
+#ifdef __linux__
+std::optional<struct ucred> ReceiveBatch::credentials(const std::size_t index) const
+{
+    // CMSG_NXTHDR() takes a non-const header but does not modify it.
+    auto & header = const_cast<struct msghdr &>(headers[index].msg_hdr);
+
+    for (const struct cmsghdr * control = CMSG_FIRSTHDR(&header);
+        control != nullptr;
+        control = CMSG_NXTHDR(&header, const_cast<struct cmsghdr *>(control)))
+    {
+        if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_CREDENTIALS)
+        {
+            struct ucred credentials;
+            std::memcpy(&credentials, CMSG_DATA(control), sizeof(credentials));
+            return credentials;
+        }
+    }
+
+    return std::nullopt;
+}
+#endif
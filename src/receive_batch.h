@@ -0,0 +1,51 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// How Listener takes datagrams off its sockets.
+enum class ReceiveBackend
+{
+    // recvmmsg() after the reactor reports the socket readable.
+    Socket,
+    // Multishot receives into provided buffers through io_uring; falls back to Socket where
+    // io_uring is not available.
+    IoUring
+};
+
+// Receives every queued datagram, up to capacity, with a single recvmmsg() where available.
+struct ReceiveBatch
+{
+    static constexpr std::size_t capacity = 64;
+    static constexpr std::size_t buffer_size = 1024;
+
+    ReceiveBatch();
+
+    // Returns the number of datagrams received; 0 if nothing was pending.
+    std::size_t receive(int fd);
+
+#ifdef __linux__
+    // Credentials of the sender of a datagram from an AF_UNIX socket with SO_PASSCRED set.
+    std::optional<struct ucred> credentials(std::size_t index) const;
+#endif
+
+    std::array<std::array<char, buffer_size>, capacity> buffers;
+    std::array<struct sockaddr_storage, capacity> senders;
+    std::array<socklen_t, capacity> sender_sizes;
+    std::array<std::size_t, capacity> sizes;
+    // Receive syscalls made so far.
+    std::uint64_t syscalls = 0;
+
+#ifdef __linux__
+    std::array<struct iovec, capacity> iovecs;
+    std::array<struct mmsghdr, capacity> headers;
+    std::array<std::array<char, CMSG_SPACE(sizeof(struct ucred))>, capacity> controls;
+#endif
+};
@@ -0,0 +1,255 @@
+#include "resolver.h"
+#include "transport.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/un.h>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+// How soon to retry endpoints that failed to resolve.
+constexpr auto retry_interval = 5s;
+
+bool parse_numeric(const std::string & host, const std::string & port, struct sockaddr_storage & address)
+{
+    const auto port_number = htons(std::strtoul(port.c_str(), nullptr, 10));
+    address = {};
+
+    auto * const ipv4 = reinterpret_cast<struct sockaddr_in *>(&address);
+    if (::inet_pton(AF_INET, host.c_str(), &ipv4->sin_addr) == 1)
+    {
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = port_number;
+        return true;
+    }
+
+    auto * const ipv6 = reinterpret_cast<struct sockaddr_in6 *>(&address);
+    if (::inet_pton(AF_INET6, host.c_str(), &ipv6->sin6_addr) == 1)
+    {
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = port_number;
+        return true;
+    }
+
+    return false;
+}
+
+Addresses lookup_hosts_file(const char * const path, const Endpoint & endpoint)
+{
+    Addresses result;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string address;
+        std::string name;
+
+        if (!(fields >> address))
+        {
+            continue;
+        }
+
+        while (fields >> name)
+        {
+            struct sockaddr_storage storage;
+
+            if (name == endpoint.host && parse_numeric(address, endpoint.port, storage))
+            {
+                result.push_back(storage);
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+}
+
+Resolver::Resolver(
+    const std::vector<Endpoint> & endpoints,
+    const std::chrono::seconds ttl,
+    OnResolved on_resolved,
+    Lookup lookup)
+    : endpoints_{endpoints}
+    , ttl_{ttl}
+    , on_resolved_{std::move(on_resolved)}
+    , lookup_{std::move(lookup)}
+    , resolved_{std::make_shared<const ResolvedEndpoints>(endpoints.size())}
+{
+    assert(on_resolved_ != nullptr);
+    assert(lookup_ != nullptr);
+}
+
+std::shared_ptr<const ResolvedEndpoints> Resolver::resolved() const
+{
+    return std::atomic_load(&resolved_);
+}
+
+Addresses Resolver::lookup_endpoint(const Endpoint & endpoint)
+{
+    if (is_unix_host(endpoint.host))
+    {
+        struct sockaddr_storage address;
+
+        if (make_unix_address(unix_socket_name(endpoint.host), address) == 0)
+        {
+            return {};
+        }
+
+        return {address};
+    }
+
+    if (const char * const hosts_path = std::getenv("KBD_LAYOUT_SYNC_HOSTS"))
+    {
+        Addresses result = lookup_hosts_file(hosts_path, endpoint);
+
+        if (!result.empty())
+        {
+            return result;
+        }
+    }
+
+    struct addrinfo hints = {};
+    struct addrinfo * info = nullptr;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (::getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &info) != 0)
+    {
+        return {};
+    }
+
+    Addresses result;
+
+    for (const struct addrinfo * it = info; it != nullptr; it = it->ai_next)
+    {
+        struct sockaddr_storage address = {};
+        std::memcpy(&address, it->ai_addr, std::min<std::size_t>(it->ai_addrlen, sizeof(address)));
+        result.push_back(address);
+    }
+
+    ::freeaddrinfo(info);
+    return result;
+}
+
+void Resolver::run()
+{
+    struct pollfd poll_fd{wakeup_fd(), POLLIN, 0};
+
+    while (true)
+    {
+        const auto previous = std::atomic_load(&resolved_);
+        auto resolved = std::make_shared<ResolvedEndpoints>();
+        bool complete = true;
+
+        for (std::size_t i = 0; i < endpoints_.size(); ++i)
+        {
+            Addresses addresses = lookup_(endpoints_[i]);
+
+            // A failed lookup, e.g. a DNS timeout or a link flap, keeps the addresses that worked
+            // last; only endpoints that never resolved are retried early.
+            if (addresses.empty())
+            {
+                addresses = (*previous)[i];
+            }
+
+            complete = complete && !addresses.empty();
+            resolved->push_back(std::move(addresses));
+        }
+
+        const bool changed = !std::equal(
+            resolved->begin(), resolved->end(),
+            previous->begin(), previous->end(),
+            [](const Addresses & lhs, const Addresses & rhs)
+            {
+                return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), same_address);
+            });
+
+        if (changed)
+        {
+            std::atomic_store(&resolved_, std::shared_ptr<const ResolvedEndpoints>{std::move(resolved)});
+            on_resolved_();
+        }
+
+        const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+            complete ? ttl_ : std::min<std::chrono::seconds>(ttl_, retry_interval));
+
+        if (::poll(&poll_fd, 1, timeout.count()) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll()");
+        }
+
+        if (should_stop())
+        {
+            break;
+        }
+    }
+}
+
+socklen_t address_size(const struct sockaddr_storage & address)
+{
+    if (address.ss_family == AF_UNIX)
+    {
+        const auto & unix_address = reinterpret_cast<const struct sockaddr_un &>(address);
+        const char * const path = unix_address.sun_path;
+        constexpr std::size_t path_size = sizeof(unix_address.sun_path);
+
+        // Abstract names start with a NUL and are not terminated.
+        return offsetof(struct sockaddr_un, sun_path) + (path[0] == '\0'
+            ? 1 + ::strnlen(path + 1, path_size - 1)
+            : std::min(::strnlen(path, path_size) + 1, path_size));
+    }
+
+    return address.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+bool same_address(const struct sockaddr_storage & lhs, const struct sockaddr_storage & rhs)
+{
+    if (lhs.ss_family != rhs.ss_family)
+    {
+        return false;
+    }
+
+    if (lhs.ss_family == AF_INET)
+    {
+        const auto & lhs4 = reinterpret_cast<const struct sockaddr_in &>(lhs);
+        const auto & rhs4 = reinterpret_cast<const struct sockaddr_in &>(rhs);
+        return lhs4.sin_port == rhs4.sin_port && lhs4.sin_addr.s_addr == rhs4.sin_addr.s_addr;
+    }
+
+    if (lhs.ss_family == AF_INET6)
+    {
+        const auto & lhs6 = reinterpret_cast<const struct sockaddr_in6 &>(lhs);
+        const auto & rhs6 = reinterpret_cast<const struct sockaddr_in6 &>(rhs);
+        return lhs6.sin6_port == rhs6.sin6_port
+            && std::memcmp(&lhs6.sin6_addr, &rhs6.sin6_addr, sizeof(lhs6.sin6_addr)) == 0
+            && lhs6.sin6_scope_id == rhs6.sin6_scope_id;
+    }
+
+    if (lhs.ss_family == AF_UNIX)
+    {
+        const socklen_t size = address_size(lhs);
+        return size == address_size(rhs) && std::memcmp(&lhs, &rhs, size) == 0;
+    }
+
+    return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "endpoint.h"
+#include "worker.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <sys/socket.h>
+
+using Addresses = std::vector<struct sockaddr_storage>;
+// Addresses of each endpoint, in the order the endpoints were given; empty while unresolved.
+using ResolvedEndpoints = std::vector<Addresses>;
+using Lookup = std::function<Addresses(const Endpoint &)>;
+using OnResolved = std::function<void()>;
+
+// Resolves endpoints on a background thread and caches the results for ttl, so that neither
+// starting nor sending ever waits for DNS. on_resolved is called from the resolver thread whenever
+// the addresses of any endpoint change; a lookup that fails keeps the previous addresses.
+class Resolver : public Worker
+{
+public:
+    Resolver(
+        const std::vector<Endpoint> & endpoints,
+        std::chrono::seconds ttl,
+        OnResolved on_resolved,
+        Lookup lookup = lookup_endpoint);
+
+    std::shared_ptr<const ResolvedEndpoints> resolved() const;
+
+    // getaddrinfo() for any address family, preceded by the hosts(5)-format file named by the
+    // KBD_LAYOUT_SYNC_HOSTS environment variable if it is set. "unix:" hosts give their AF_UNIX
+    // address without a lookup.
+    static Addresses lookup_endpoint(const Endpoint & endpoint);
+
+protected:
+    void run() override;
+
+private:
+    const std::vector<Endpoint> endpoints_;
+    const std::chrono::seconds ttl_;
+    const OnResolved on_resolved_;
+    const Lookup lookup_;
+    std::shared_ptr<const ResolvedEndpoints> resolved_;
+};
+
+socklen_t address_size(const struct sockaddr_storage & address);
+bool same_address(const struct sockaddr_storage & lhs, const struct sockaddr_storage & rhs);
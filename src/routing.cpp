@@ -0,0 +1,81 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "routing.h"
+
+#include <algorithm>
+#include <charconv>
+
+std::string_view EncodedLayout::layout() const
+{
+    return size > protocol::header_size
+        ? std::string_view(packet.data() + protocol::header_size, size - protocol::header_size)
+        : std::string_view{};
+}
+
+GroupRoutes::GroupRoutes(const std::map<std::string, std::string> & keyboard_groups)
+{
+    for (const auto & [group_name, layout] : keyboard_groups)
+    {
+        std::size_t group = 0;
+        const char * const end = group_name.data() + group_name.size();
+        const auto [parsed_end, error] = std::from_chars(group_name.data(), end, group);
+
+        if (error != std::errc{} || parsed_end != end || group >= max_groups)
+        {
+            continue;
+        }
+
+        protocol::Message message;
+        message.layout = layout;
+
+        EncodedLayout & route = routes_[group];
+        route.size = protocol::encode(message, route.packet.data(), route.packet.size());
+    }
+}
+
+const EncodedLayout * GroupRoutes::find(const std::int32_t group) const
+{
+    if (group < 0 || static_cast<std::size_t>(group) >= max_groups || routes_[group].size == 0)
+    {
+        return nullptr;
+    }
+
+    return &routes_[group];
+}
+
+LayoutTable::LayoutTable(const std::map<std::string, std::string> & keyboard_groups)
+{
+    names_.reserve(max_layouts);
+
+    for (const auto & [group_name, layout] : keyboard_groups)
+    {
+        intern(layout);
+    }
+}
+
+LayoutTable::Id LayoutTable::find(const std::string_view layout) const
+{
+    const auto name_it = std::find(names_.cbegin(), names_.cend(), layout);
+    return name_it != names_.cend() ? static_cast<Id>(name_it - names_.cbegin()) : none;
+}
+
+LayoutTable::Id LayoutTable::intern(const std::string_view layout)
+{
+    if (const Id id = find(layout); id != none)
+    {
+        return id;
+    }
+
+    if (layout.empty() || names_.size() >= max_layouts)
+    {
+        return none;
+    }
+
+    names_.emplace_back(layout);
+    return names_.size() - 1;
+}
+
+const std::string & LayoutTable::name(const Id id) const
+{
+    return names_.at(id);
+}
@@ -0,0 +1,66 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "protocol.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A layout message encoded ahead of time. Only the per-packet header fields are filled in when
+// it is sent, see protocol::stamp().
+struct EncodedLayout
+{
+    // The layout name inside packet.
+    std::string_view layout() const;
+
+    std::array<char, protocol::max_packet_size> packet = {};
+    std::size_t size = 0;
+};
+
+// Sender side of Settings::keyboard_groups, compiled once per settings change into a table
+// indexed by XKB group. Entries whose key is not a group number or whose layout does not fit in a
+// packet are ignored.
+class GroupRoutes
+{
+public:
+    // XkbNumKbdGroups; spelled out so that this does not depend on the X11 headers.
+    static constexpr std::size_t max_groups = 4;
+
+    explicit GroupRoutes(const std::map<std::string, std::string> & keyboard_groups);
+
+    // Returns nullptr if the group is not mapped.
+    const EncodedLayout * find(std::int32_t group) const;
+
+private:
+    std::array<EncodedLayout, max_groups> routes_;
+};
+
+// Receiver side: interns layout names so that LayoutApplier compares small integers instead of
+// strings. It is seeded with the layouts of Settings::keyboard_groups, which are the names peers
+// sharing the configuration send; other names are added the first time they arrive, up to
+// max_layouts.
+class LayoutTable
+{
+public:
+    using Id = std::size_t;
+
+    static constexpr Id none = static_cast<Id>(-1);
+    static constexpr std::size_t max_layouts = 64;
+
+    explicit LayoutTable(const std::map<std::string, std::string> & keyboard_groups = {});
+
+    // Returns none if the layout has not been seen.
+    Id find(std::string_view layout) const;
+    // Returns none for empty names and once the table is full.
+    Id intern(std::string_view layout);
+    const std::string & name(Id id) const;
+
+private:
+    std::vector<std::string> names_;
+};
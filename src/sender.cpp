@@ -1,141 +1,237 @@
 #include "sender.h"
+#include "protocol.h"
 
-#include <cstdlib>
+#include <algorithm>
 #include <stdexcept>
 
 #include <X11/XKBlib.h>
 #include <X11/Xutil.h>
-#include <arpa/inet.h>
-#include <errno.h>
-#include <netdb.h>
-#include <poll.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
-namespace
+Sender::Sender(
+    const std::vector<Endpoint> & receivers,
+    const TransportOptions & transport,
+    const bool reliable,
+    const bool trace_latency,
+    const std::map<std::string, std::string> & keyboard_groups,
+    std::shared_ptr<PeerState> peer_state,
+    const std::chrono::milliseconds coalescing_window)
+    : transmit_stage_{
+        receivers,
+        transport,
+        reliable,
+        trace_latency,
+        keyboard_groups,
+        peer_state}
+    , coalescing_window_{coalescing_window}
+    , announce_{peer_state == nullptr}
 {
+}
 
-void send_impl(const int fd, const char * const buf, const std::size_t size) {
-    for (int retry = 5; retry >= 0; --retry) {
-        const auto sent_size = ::send(fd, buf, size, 0);
+Sender::~Sender()
+{
+    close();
+    wait_closed();
+}
 
-        if (sent_size == size)
-        {
-            break;
-        }
+std::vector<int> Sender::open()
+{
+    Display * const display = XOpenDisplay(NULL);
 
-        if (sent_size < 0 && (errno != ECONNREFUSED || retry == 0))
-        {
-            throw std::runtime_error("send()");
-        }
+    if (display == nullptr)
+    {
+        throw std::runtime_error("XOpenDisplay()");
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    XkbQueryExtension(display, 0, &xkb_event_type_, 0, 0, 0);
+    // Only group changes matter; selecting every XKB event would wake the reactor on each modifier
+    // press, bell and indicator change.
+    XkbSelectEventDetails(display, XkbUseCoreKbd, XkbStateNotify, XkbGroupStateMask, XkbGroupStateMask);
+    XSync(display, False);
+
+    display_ = display;
+    last_lang_ = -1;
+    last_sent_lang_ = -1;
+    pending_change_.reset();
+    window_deadline_.reset();
+
+    // Sending runs on its own thread so that network I/O never delays draining the X connection.
+    transmit_stage_.start();
+
+    if (XkbStateRec state; announce_ && XkbGetState(display_, XkbUseCoreKbd, &state) == Success)
+    {
+        // Receivers that started first, or missed the last change, learn the current group.
+        last_lang_ = state.group;
+        last_sent_lang_ = state.group;
+        transmit_stage_.post({state.group, protocol::now_us()});
     }
+
+    return {ConnectionNumber(display_)};
 }
 
+void Sender::close()
+{
+    if (display_ == nullptr)
+    {
+        return;
+    }
+
+    // Joining here would freeze the reactor while the transmit thread waits for its resolver, which
+    // may be stuck in getaddrinfo(); wait_closed() or the destructor joins it instead.
+    transmit_stage_.request_stop();
+    XCloseDisplay(display_);
+    display_ = nullptr;
 }
 
-Sender::Sender(
-    const std::string & host,
-    const std::string & port,
-    const std::map<std::string, std::string> & keyboard_groups)
-    : host_{host}
-    , port_{port}
-    , keyboard_groups_{keyboard_groups}
+void Sender::wait_closed()
 {
+    transmit_stage_.stop();
 }
 
-void Sender::run()
+void Sender::on_readable(int)
 {
-    Display * const display = XOpenDisplay(NULL);
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    process_events();
+}
 
-    if (display == nullptr)
+int Sender::prepare()
+{
+    // A transmit thread that died, e.g. on a socket error, would leave the sender capturing changes
+    // that nobody sends; failing here makes the reactor close the sender and log it instead.
+    if (!transmit_stage_.running())
     {
-        throw std::runtime_error("XOpenDisplay()");
+        throw std::runtime_error("transmit stage stopped");
     }
 
-    const int fd = ::socket(PF_INET, SOCK_DGRAM, 0);
+    // Events that Xlib already buffered, e.g. while answering XSync(), never make the fd readable
+    // again, so they are drained before every wait.
+    process_events();
 
-    if (fd < 0)
+    if (!window_deadline_)
     {
-        throw std::runtime_error("socket()");
+        return -1;
     }
 
-    struct hostent * const host = ::gethostbyname(host_.c_str());
+    const auto remaining =
+        std::chrono::ceil<std::chrono::milliseconds>(*window_deadline_ - Clock::now()).count();
+    return std::max<decltype(remaining)>(remaining, 0);
+}
 
-    if (!host)
+void Sender::on_timeout()
+{
+    if (!window_deadline_ || Clock::now() < *window_deadline_)
     {
-        throw std::runtime_error("gethostbyname()");
+        return;
     }
 
-    struct sockaddr_in name;
+    // Trailing edge: the group has settled.
+    window_deadline_.reset();
 
-    name.sin_family = AF_INET;
-    name.sin_port = htons(std::strtoul(port_.c_str(), nullptr, 10));
-    name.sin_addr = *(struct in_addr *)host->h_addr;
-
-    if (::connect(fd, (struct sockaddr *)&name, sizeof(name)) < 0)
+    if (!pending_change_)
     {
-        throw std::runtime_error("connect()");
+        return;
     }
 
-    int xkb_event_type;
-
-    XkbQueryExtension(display, 0, &xkb_event_type, 0, 0, 0);
-    XkbSelectEvents(display, XkbUseCoreKbd, XkbAllEventsMask, XkbAllEventsMask);
-    XSync(display, False);
+    if (pending_change_->group != last_sent_lang_)
+    {
+        last_sent_lang_ = pending_change_->group;
+        transmit_stage_.post(*pending_change_);
+    }
+    else
+    {
+        suppressed_updates_.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    int last_lang = -1;
+    pending_change_.reset();
+}
 
-    const int listen_fd = ConnectionNumber(display);
-    struct pollfd poll_fd{listen_fd, POLLIN, 0};
+void Sender::on_group_change(const GroupChange & change)
+{
+    if (coalescing_window_.count() == 0)
+    {
+        transmit_stage_.post(change);
+        return;
+    }
 
-    while (true)
+    if (!window_deadline_)
     {
-        if (::poll(&poll_fd, 1, 1000) < 0)
+        // Leading edge: nothing was sent for a while, so a single switch costs no extra latency.
+        last_sent_lang_ = change.group;
+        transmit_stage_.post(change);
+    }
+    else
+    {
+        if (pending_change_)
         {
-            throw std::runtime_error("poll()");
+            suppressed_updates_.fetch_add(1, std::memory_order_relaxed);
         }
 
-        if (should_stop())
-        {
-            break;
-        }
+        // Keeps the capture time, so that traced latencies include the time spent held back.
+        pending_change_ = change;
+    }
 
-        if ((poll_fd.revents & POLLIN) == 0)
+    // Every change extends the window, so that the trailing edge waits for the group to settle.
+    window_deadline_ = Clock::now() + coalescing_window_;
+}
+
+void Sender::process_events()
+{
+    while (XPending(display_))
+    {
+        XEvent event;
+        XNextEvent(display_, &event);
+        x_events_.fetch_add(1, std::memory_order_relaxed);
+
+        if (event.type != xkb_event_type_)
         {
             continue;
         }
 
-        while (XPending(display))
+        const XkbEvent * const xkb_event = reinterpret_cast<const XkbEvent *>(&event);
+
+        if (xkb_event->any.xkb_type == XkbStateNotify
+            && (xkb_event->state.changed & XkbGroupStateMask) != 0)
         {
-            XEvent event;
-            XNextEvent(display, &event);
-            if (event.type == xkb_event_type)
+            group_change_events_.fetch_add(1, std::memory_order_relaxed);
+
+            const int lang = xkb_event->state.group;
+
+            if (lang == last_lang_)
             {
-                const XkbEvent * const xkb_event = reinterpret_cast<const XkbEvent *>(&event);
+                continue;
+            }
 
-                if (xkb_event->any.xkb_type == XkbStateNotify)
-                {
-                    const int lang = xkb_event->state.group;
+            last_lang_ = lang;
+            on_group_change({lang, protocol::now_us()});
+        }
+    }
+}
 
-                    if (lang == last_lang)
-                    {
-                        continue;
-                    }
+void Sender::set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups)
+{
+    transmit_stage_.set_keyboard_groups(keyboard_groups);
+}
 
-                    last_lang = lang;
+const TransmitStage & Sender::transmit_stage() const
+{
+    return transmit_stage_;
+}
+
+std::uint64_t Sender::wakeups() const
+{
+    return wakeups_.load(std::memory_order_relaxed);
+}
 
-                    const auto group_it = keyboard_groups_.find(std::to_string(lang));
+std::uint64_t Sender::x_events() const
+{
+    return x_events_.load(std::memory_order_relaxed);
+}
 
-                    if (group_it != keyboard_groups_.cend())
-                    {
-                        send_impl(fd, group_it->second.data(), group_it->second.size());
-                    }
-                }
-            }
-        }
-    }
+std::uint64_t Sender::group_change_events() const
+{
+    return group_change_events_.load(std::memory_order_relaxed);
+}
 
-    ::close(fd);
+std::uint64_t Sender::suppressed_updates() const
+{
+    return suppressed_updates_.load(std::memory_order_relaxed);
 }
@@ -1,25 +1,84 @@
 #pragma once
 
-#include "worker.h"
+#include "endpoint.h"
+#include "reactor.h"
+#include "transmit_stage.h"
+#include "transport.h"
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <map>
-#include <thread>
+#include <memory>
 #include <atomic>
+#include <optional>
+#include <vector>
 
-class Sender : public Worker
+#include <X11/Xlib.h>
+
+// Captures group changes from the X connection as a Reactor handler and hands them to its own
+// TransmitStage, so that network I/O never delays the reactor. With a coalescing window, the first
+// change after a quiet period is sent at once and further changes are held until none has come for
+// the window; only the group they settled on is sent then, e.g. once after cycling through layouts.
+// The group that is active when the sender opens is announced right away, except in peer mode, where
+// a starting peer adopts the others' layout from their heartbeats instead of imposing its own.
+class Sender : public EventHandler
 {
 public:
     Sender(
-        const std::string & host,
-        const std::string & port,
-        const std::map<std::string, std::string> & keyboard_groups);
+        const std::vector<Endpoint> & receivers,
+        const TransportOptions & transport,
+        bool reliable,
+        bool trace_latency,
+        const std::map<std::string, std::string> & keyboard_groups,
+        std::shared_ptr<PeerState> peer_state = nullptr,
+        std::chrono::milliseconds coalescing_window = {});
+    ~Sender() override;
+
+    // Remaps groups without restarting; see TransmitStage::set_keyboard_groups().
+    void set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups);
+
+    const TransmitStage & transmit_stage() const;
+
+    // close() only signals the transmit thread, as it runs on the reactor thread; this waits for the
+    // thread to exit. Must be called before the sender is opened again, never on the reactor thread.
+    void wait_closed();
+
+    // Reactor wakeups for the X connection, X events received, and how many of those carried a
+    // group change.
+    std::uint64_t wakeups() const;
+    std::uint64_t x_events() const;
+    std::uint64_t group_change_events() const;
+    // Changes held back by the coalescing window that were never sent, because a later one
+    // superseded them or the group settled back on the one sent last.
+    std::uint64_t suppressed_updates() const;
+
+    std::vector<int> open() override;
+    void close() override;
+    void on_readable(int fd) override;
+    int prepare() override;
+    void on_timeout() override;
+
+private:
+    using Clock = std::chrono::steady_clock;
 
-protected:
-    void run() override;
+    void process_events();
+    void on_group_change(const GroupChange & change);
 
 private:
-    const std::string host_;
-    const std::string port_;
-    const std::map<std::string, std::string> keyboard_groups_;
+    TransmitStage transmit_stage_;
+    const std::chrono::milliseconds coalescing_window_;
+    const bool announce_;
+    Display * display_ = nullptr;
+    int xkb_event_type_ = 0;
+    int last_lang_ = -1;
+    int last_sent_lang_ = -1;
+    // The newest change held back by the window.
+    std::optional<GroupChange> pending_change_;
+    // When the trailing edge is due; unset while no window is open.
+    std::optional<Clock::time_point> window_deadline_;
+    std::atomic<std::uint64_t> wakeups_{0};
+    std::atomic<std::uint64_t> x_events_{0};
+    std::atomic<std::uint64_t> group_change_events_{0};
+    std::atomic<std::uint64_t> suppressed_updates_{0};
 };
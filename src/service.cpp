@@ -0,0 +1,397 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "service.h"
+#include "layout_backend.h"
+#include "protocol.h"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+Service::Service(Settings settings)
+    : settings_{std::move(settings)}
+    , layout_applier_{make_layout_applier(settings_)}
+    , listener_{make_listener(settings_)}
+#if HAS_X11
+    , sender_{make_sender(settings_)}
+    , xkb_state_watcher_{make_xkb_state_watcher()}
+#endif
+    , metrics_server_{make_metrics_server(settings_.metrics_address)}
+{
+    reactor_.start();
+}
+
+Service::~Service()
+{
+    // Stopped first: a scrape in progress waits for mutex_.
+    metrics_server_.reset();
+
+    const std::scoped_lock lock{mutex_};
+    // Closes every handler that is still registered.
+    reactor_.stop();
+}
+
+std::shared_ptr<LayoutApplier> Service::make_layout_applier(const Settings & settings) const
+{
+    return std::make_shared<LayoutApplier>(
+        make_layout_backend(settings),
+        LayoutTable{settings.keyboard_groups});
+}
+
+std::unique_ptr<Listener> Service::make_listener(const Settings & settings)
+{
+    return std::make_unique<Listener>(
+        settings.receiver_host,
+        settings.receiver_port,
+        settings.transport,
+        [this](const protocol::Message & message)
+        {
+            const auto layout_applier = std::atomic_load(&layout_applier_);
+
+            // Heartbeats only repair a layout that drifted, e.g. after a lost packet; their
+            // timestamps are old, so they are not traced.
+            if ((message.flags & protocol::flag_heartbeat) != 0)
+            {
+                layout_applier->reconcile(message.layout);
+                return;
+            }
+
+            const auto begin = std::chrono::steady_clock::now();
+
+            if (layout_applier->apply(message.layout)
+                && (message.flags & protocol::flag_capture_timestamp) != 0)
+            {
+                const auto end = std::chrono::steady_clock::now();
+                const std::uint64_t applied_us = protocol::now_us();
+
+                latency_tracer_->record(
+                    LatencyStage::Apply,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+                latency_tracer_->record(
+                    LatencyStage::Total,
+                    applied_us > message.timestamp_us ? (applied_us - message.timestamp_us) * 1000 : 0);
+            }
+        },
+        latency_tracer_,
+        settings.receive_backend);
+}
+
+std::unique_ptr<MetricsServer> Service::make_metrics_server(const std::string & address)
+{
+    if (address.empty())
+    {
+        return nullptr;
+    }
+
+    auto metrics_server = std::make_unique<MetricsServer>(
+        address,
+        [this](MetricsWriter & writer)
+        {
+            collect_metrics(writer);
+        });
+
+    metrics_server->start();
+    return metrics_server;
+}
+
+bool Service::start_listener()
+{
+    const std::scoped_lock lock{mutex_};
+    const bool started = reactor_.add(*listener_);
+#if HAS_X11
+    // Keeps the applier's idea of the active layout correct when it is switched locally.
+    reactor_.add(*xkb_state_watcher_);
+#endif
+    return started;
+}
+
+void Service::stop()
+{
+    const std::scoped_lock lock{mutex_};
+    reactor_.remove(*listener_);
+#if HAS_X11
+    reactor_.remove(*xkb_state_watcher_);
+    reactor_.remove(*sender_);
+    sender_->wait_closed();
+    set_peer_mode(false);
+#endif
+}
+
+void Service::apply_settings(const Settings & settings)
+{
+    // Replaced before mutex_ is taken, since collecting metrics takes it; settings_ is only written
+    // on the controlling thread. The old server goes first so that the new one can bind the same
+    // address.
+    if (settings.metrics_address != settings_.metrics_address)
+    {
+        metrics_server_.reset();
+        metrics_server_ = make_metrics_server(settings.metrics_address);
+    }
+
+    // Only the parts affected by the change are rebuilt; everything else, including sockets and X
+    // connections, keeps running.
+    const std::scoped_lock lock{mutex_};
+    const Settings previous = std::exchange(settings_, settings);
+
+    if (previous.layout_backend != settings_.layout_backend
+        || previous.xkbswitchlib_path != settings_.xkbswitchlib_path)
+    {
+        std::atomic_store(&layout_applier_, make_layout_applier(settings_));
+    }
+    else if (previous.keyboard_groups != settings_.keyboard_groups)
+    {
+        std::atomic_load(&layout_applier_)->set_keyboard_groups(settings_.keyboard_groups);
+    }
+
+    if (previous.receiver_host != settings_.receiver_host
+        || previous.receiver_port != settings_.receiver_port
+        || previous.transport != settings_.transport
+        || previous.receive_backend != settings_.receive_backend)
+    {
+        const bool is_listener_running = reactor_.contains(*listener_);
+        reactor_.remove(*listener_);
+        listener_ = make_listener(settings_);
+#if HAS_X11
+        listener_->set_peer_state(peer_state_);
+#endif
+
+        if (is_listener_running)
+        {
+            reactor_.add(*listener_);
+        }
+    }
+
+#if HAS_X11
+    if (transmit_endpoints(previous) != transmit_endpoints(settings_)
+        || previous.transport != settings_.transport
+        || previous.reliable_delivery != settings_.reliable_delivery
+        || previous.trace_latency != settings_.trace_latency
+        || previous.coalescing_window_ms != settings_.coalescing_window_ms)
+    {
+        const bool is_sender_running = reactor_.contains(*sender_);
+        reactor_.remove(*sender_);
+        sender_ = make_sender(settings_);
+
+        if (is_sender_running)
+        {
+            reactor_.add(*sender_);
+        }
+    }
+    else if (previous.keyboard_groups != settings_.keyboard_groups)
+    {
+        sender_->set_keyboard_groups(settings_.keyboard_groups);
+    }
+#endif
+}
+
+std::string Service::latency_report() const
+{
+    return latency_tracer_->report();
+}
+
+// Runs on the metrics server's thread.
+void Service::collect_metrics(MetricsWriter & writer)
+{
+    const auto name = [](const char * metric)
+    {
+        return std::string{"kbd_layout_sync_"} + metric;
+    };
+
+    const std::scoped_lock lock{mutex_};
+
+    const std::vector<ListenerSocketStats> socket_stats = listener_->socket_stats();
+
+    writer.gauge(
+        name("listener_sockets"),
+        "Sockets the receiver is listening on.",
+        socket_stats.size());
+
+    for (const auto & stats : socket_stats)
+    {
+        writer.counter(
+            name("packets_received_total"),
+            "Packets received.",
+            stats.packets,
+            {{"socket", stats.address}});
+    }
+
+    for (const auto & stats : socket_stats)
+    {
+        writer.counter(
+            name("receive_syscalls_total"),
+            "Syscalls spent receiving packets.",
+            stats.receive_syscalls,
+            {{"socket", stats.address}});
+    }
+
+    writer.counter(
+        name("packets_coalesced_total"),
+        "Packets superseded by a newer one from the same batch.",
+        listener_->coalesced_packets());
+    writer.counter(
+        name("packets_stale_total"),
+        "Duplicate or out-of-order packets.",
+        listener_->stale_packets());
+    writer.counter(
+        name("packets_rejected_total"),
+        "Packets from other users on a unix socket.",
+        listener_->rejected_packets());
+    writer.counter(
+        name("parse_failures_total"),
+        "Packets that were not valid messages.",
+        listener_->parse_failures());
+
+    const auto layout_applier = std::atomic_load(&layout_applier_);
+
+    writer.counter(
+        name("layouts_skipped_total"),
+        "Layouts that were already active.",
+        layout_applier->skipped_count());
+    writer.counter(
+        name("layouts_repaired_total"),
+        "Heartbeats that found a different layout active.",
+        layout_applier->repaired_count());
+    writer.summary(
+        name("set_layout_seconds"),
+        "Time spent setting layouts.",
+        std::chrono::duration<double>(layout_applier->set_layout_time()).count(),
+        layout_applier->applied_count());
+
+    writer.counter(
+        name("handler_failures_total"),
+        "Reactor handlers that failed and were stopped.",
+        reactor_.handler_failures());
+    writer.counter(
+        name("worker_starts_total"),
+        "Worker thread starts.",
+        reactor_.starts(),
+        {{"worker", "reactor"}});
+#if HAS_X11
+    writer.counter(
+        name("worker_starts_total"),
+        "Worker thread starts.",
+        sender_->transmit_stage().starts(),
+        {{"worker", "transmitter"}});
+#endif
+    writer.counter(
+        name("worker_failures_total"),
+        "Worker threads that stopped with an error.",
+        reactor_.failures(),
+        {{"worker", "reactor"}});
+#if HAS_X11
+    writer.counter(
+        name("worker_failures_total"),
+        "Worker threads that stopped with an error.",
+        sender_->transmit_stage().failures(),
+        {{"worker", "transmitter"}});
+
+    const TransmitStage & transmit_stage = sender_->transmit_stage();
+    const TransmitterStats & transmitter_stats = transmit_stage.transmitter_stats();
+
+    writer.counter(name("x_wakeups_total"), "Wakeups for the X connection.", sender_->wakeups());
+    writer.counter(name("x_events_total"), "X events processed.", sender_->x_events());
+    writer.counter(
+        name("group_changes_total"),
+        "Keyboard group changes captured.",
+        sender_->group_change_events());
+    writer.counter(
+        name("updates_suppressed_total"),
+        "Group changes coalesced away.",
+        sender_->suppressed_updates());
+    writer.counter(
+        name("changes_dropped_total"),
+        "Group changes dropped by a full queue.",
+        transmit_stage.dropped_changes());
+    writer.counter(
+        name("packets_sent_total"),
+        "Packets sent.",
+        transmitter_stats.packets_sent.load(std::memory_order_relaxed));
+    writer.counter(
+        name("retransmits_total"),
+        "Unacknowledged updates sent again.",
+        transmitter_stats.retransmits.load(std::memory_order_relaxed));
+    writer.counter(
+        name("send_retries_total"),
+        "Sends repeated after an interruption.",
+        transmitter_stats.send_retries.load(std::memory_order_relaxed));
+    writer.counter(
+        name("send_errors_total"),
+        "Packets that could not be sent.",
+        transmitter_stats.send_errors.load(std::memory_order_relaxed));
+    writer.counter(
+        name("acks_received_total"),
+        "Acks received.",
+        transmitter_stats.acks_received.load(std::memory_order_relaxed));
+    writer.counter(
+        name("heartbeats_sent_total"),
+        "Heartbeats sent.",
+        transmit_stage.heartbeats_sent());
+    writer.gauge(
+        name("rtt_seconds"),
+        "Smoothed round-trip time of acknowledged updates.",
+        transmitter_stats.rtt_us.load(std::memory_order_relaxed) / 1e6);
+#endif
+}
+
+#if HAS_X11
+std::unique_ptr<Sender> Service::make_sender(const Settings & settings)
+{
+    return std::make_unique<Sender>(
+        transmit_endpoints(settings),
+        settings.transport,
+        settings.reliable_delivery,
+        settings.trace_latency,
+        settings.keyboard_groups,
+        peer_state_,
+        std::chrono::milliseconds(settings.coalescing_window_ms));
+}
+
+std::unique_ptr<XkbStateWatcher> Service::make_xkb_state_watcher()
+{
+    return std::make_unique<XkbStateWatcher>(
+        [this](int)
+        {
+            std::atomic_load(&layout_applier_)->refresh();
+        });
+}
+
+bool Service::start_sender()
+{
+    const std::scoped_lock lock{mutex_};
+    // The transmit thread may still be exiting from an earlier close on the reactor thread.
+    sender_->wait_closed();
+    return reactor_.add(*sender_);
+}
+
+bool Service::start_peer()
+{
+    const std::scoped_lock lock{mutex_};
+    set_peer_mode(true);
+    const bool listener_started = reactor_.add(*listener_);
+    reactor_.add(*xkb_state_watcher_);
+    sender_->wait_closed();
+    const bool sender_started = reactor_.add(*sender_);
+    return listener_started && sender_started;
+}
+
+// Expects mutex_ to be held. The sender is rebuilt because its origin and versioning come from
+// the peer state; the listener filters received updates with it.
+void Service::set_peer_mode(const bool enabled)
+{
+    if (enabled == (peer_state_ != nullptr))
+    {
+        return;
+    }
+
+    const bool is_sender_running = reactor_.contains(*sender_);
+    reactor_.remove(*sender_);
+    peer_state_ = enabled ? std::make_shared<PeerState>() : nullptr;
+    listener_->set_peer_state(peer_state_);
+    sender_ = make_sender(settings_);
+
+    if (is_sender_running)
+    {
+        reactor_.add(*sender_);
+    }
+}
+#endif
@@ -0,0 +1,83 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "config.h"
+#include "latency.h"
+#include "layout_applier.h"
+#include "listener.h"
+#include "metrics.h"
+#include "peer_state.h"
+#include "reactor.h"
+#include "settings.h"
+
+#if HAS_X11
+#include "sender.h"
+#include "xkb_state_watcher.h"
+#endif
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+// The workers behind both the tray application and the headless daemon: the listener, sender and
+// watcher on one reactor, plus the optional metrics server. Nothing here depends on a GUI. The
+// methods are meant to be called from one controlling thread; the reactor's callbacks and metric
+// scrapes run on threads of their own.
+class Service
+{
+public:
+    explicit Service(Settings settings);
+    ~Service();
+
+    Service(const Service &) = delete;
+    Service & operator=(const Service &) = delete;
+
+    // The start functions return false if the listener or the sender failed to open; the error has
+    // been logged.
+    bool start_listener();
+#if HAS_X11
+    bool start_sender();
+    // Listener, sender and watcher together, with versioned updates.
+    bool start_peer();
+#endif
+    // Stops every handler and leaves peer mode.
+    void stop();
+    // Rebuilds only the parts affected by the change; everything else, including sockets and X
+    // connections, keeps running.
+    void apply_settings(const Settings & settings);
+
+    std::string latency_report() const;
+
+private:
+    std::shared_ptr<LayoutApplier> make_layout_applier(const Settings & settings) const;
+    std::unique_ptr<Listener> make_listener(const Settings & settings);
+    std::unique_ptr<MetricsServer> make_metrics_server(const std::string & address);
+    void collect_metrics(MetricsWriter & writer);
+
+#if HAS_X11
+    std::unique_ptr<Sender> make_sender(const Settings & settings);
+    std::unique_ptr<XkbStateWatcher> make_xkb_state_watcher();
+    void set_peer_mode(bool enabled);
+#endif
+
+private:
+    std::mutex mutex_;
+    Settings settings_;
+    // Drives the listener, sender and watcher on one thread; any of them can run at the same time.
+    Reactor reactor_;
+    const std::shared_ptr<LatencyTracer> latency_tracer_ = std::make_shared<LatencyTracer>();
+    // Swapped atomically so that the running listener picks up a new backend without a restart.
+    std::shared_ptr<LayoutApplier> layout_applier_;
+    std::unique_ptr<Listener> listener_;
+
+#if HAS_X11
+    // Set in peer mode only; the listener and the sender get their own references.
+    std::shared_ptr<PeerState> peer_state_;
+    std::unique_ptr<Sender> sender_;
+    std::unique_ptr<XkbStateWatcher> xkb_state_watcher_;
+#endif
+
+    // Null unless metrics_address is set. Replaced on the controlling thread only.
+    std::unique_ptr<MetricsServer> metrics_server_;
+};
@@ -7,23 +7,109 @@
 namespace
 {
 
-QSettings make_qsettings()
+QSettings make_qsettings(const std::filesystem::path & path = settings_path())
+{
+    return QSettings(QString::fromStdString(path.string()), QSettings::IniFormat);
+}
+
+TransportMode parse_transport_mode(const QString & str)
+{
+    if (str == "multicast")
+    {
+        return TransportMode::Multicast;
+    }
+
+    if (str == "broadcast")
+    {
+        return TransportMode::Broadcast;
+    }
+
+    return TransportMode::Unicast;
+}
+
+QString to_qstring(const TransportMode mode)
+{
+    switch (mode)
+    {
+    case TransportMode::Multicast:
+        return "multicast";
+    case TransportMode::Broadcast:
+        return "broadcast";
+    case TransportMode::Unicast:
+        break;
+    }
+
+    return "unicast";
+}
+
+}
+
+std::filesystem::path settings_path()
 {
     const QString config_path = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
     assert(!config_path.isEmpty());
-    return QSettings(QDir(config_path).filePath("kb-layout-sync.ini"), QSettings::IniFormat);
+    return QDir(config_path).filePath("kb-layout-sync.ini").toStdString();
 }
 
+std::vector<Endpoint> transmit_endpoints(const Settings & settings)
+{
+    switch (settings.transport.mode)
+    {
+    case TransportMode::Multicast:
+        return {{settings.transport.multicast_group, settings.receiver_port}};
+    case TransportMode::Broadcast:
+        return {{settings.transport.broadcast_address, settings.receiver_port}};
+    case TransportMode::Unicast:
+        break;
+    }
+
+    if (settings.receivers.empty())
+    {
+        return {{settings.receiver_host, settings.receiver_port}};
+    }
+
+    return settings.receivers;
 }
 
 Settings load_settings()
 {
-    QSettings qsettings = make_qsettings();
+    return load_settings(settings_path());
+}
+
+Settings load_settings(const std::filesystem::path & path)
+{
+    QSettings qsettings = make_qsettings(path);
     Settings result;
 
     result.receiver_host = qsettings.value("receiver_host", "0.0.0.0").toString().toStdString();
     result.receiver_port = qsettings.value("receiver_port", "36032").toString().toStdString();
 
+    const int receiver_count = qsettings.beginReadArray("receivers");
+    for (int i = 0; i < receiver_count; ++i) {
+        qsettings.setArrayIndex(i);
+        std::string host = qsettings.value("host").toString().toStdString();
+        std::string port = qsettings.value("port", "36032").toString().toStdString();
+        result.receivers.push_back({std::move(host), std::move(port)});
+    }
+    qsettings.endArray();
+
+    const TransportOptions default_transport;
+    result.transport.mode = parse_transport_mode(qsettings.value("transport_mode", "unicast").toString());
+    result.transport.multicast_group = qsettings.value(
+        "multicast_group", default_transport.multicast_group.c_str()).toString().toStdString();
+    result.transport.multicast_ttl = qsettings.value("multicast_ttl", default_transport.multicast_ttl).toInt();
+    result.transport.multicast_interface = qsettings.value("multicast_interface", "").toString().toStdString();
+    result.transport.broadcast_address = qsettings.value(
+        "broadcast_address", default_transport.broadcast_address.c_str()).toString().toStdString();
+
+    result.reliable_delivery = qsettings.value("reliable_delivery", false).toBool();
+    result.trace_latency = qsettings.value("trace_latency", false).toBool();
+    result.receive_backend = qsettings.value("receive_backend", "socket").toString() == "io_uring"
+        ? ReceiveBackend::IoUring
+        : ReceiveBackend::Socket;
+    result.coalescing_window_ms = qsettings.value("coalescing_window_ms", 0).toInt();
+    result.metrics_address = qsettings.value("metrics_address", "").toString().toStdString();
+
     const int group_count = qsettings.beginReadArray("keyboard_groups");
     for (int i = 0; i < group_count; ++i) {
         qsettings.setArrayIndex(i);
@@ -33,6 +119,10 @@ Settings load_settings()
     }
     qsettings.endArray();
 
+    result.layout_backend = qsettings.value("layout_backend", "native").toString() == "xkbswitch"
+        ? LayoutBackendType::XkbSwitch
+        : LayoutBackendType::Native;
+
     result.xkbswitchlib_path =
         qsettings.value("xkbswitchlib_path", "/usr/local/lib/libxkbswitch.so").toString().toStdString();
 
@@ -46,6 +136,28 @@ void save_settings(const Settings & settings)
     qsettings.setValue("receiver_host", QString(settings.receiver_host.c_str()));
     qsettings.setValue("receiver_port", QString(settings.receiver_port.c_str()));
 
+    qsettings.beginWriteArray("receivers");
+    for (std::size_t i = 0; i < settings.receivers.size(); ++i)
+    {
+        qsettings.setArrayIndex(i);
+        qsettings.setValue("host", QString(settings.receivers[i].host.c_str()));
+        qsettings.setValue("port", QString(settings.receivers[i].port.c_str()));
+    }
+    qsettings.endArray();
+
+    qsettings.setValue("transport_mode", to_qstring(settings.transport.mode));
+    qsettings.setValue("multicast_group", QString(settings.transport.multicast_group.c_str()));
+    qsettings.setValue("multicast_ttl", settings.transport.multicast_ttl);
+    qsettings.setValue("multicast_interface", QString(settings.transport.multicast_interface.c_str()));
+    qsettings.setValue("broadcast_address", QString(settings.transport.broadcast_address.c_str()));
+
+    qsettings.setValue("reliable_delivery", settings.reliable_delivery);
+    qsettings.setValue("trace_latency", settings.trace_latency);
+    qsettings.setValue(
+        "receive_backend", settings.receive_backend == ReceiveBackend::IoUring ? "io_uring" : "socket");
+    qsettings.setValue("coalescing_window_ms", settings.coalescing_window_ms);
+    qsettings.setValue("metrics_address", QString(settings.metrics_address.c_str()));
+
     qsettings.beginWriteArray("keyboard_groups");
     auto keyboard_group_it = settings.keyboard_groups.begin();
     for (std::size_t i = 0; i < settings.keyboard_groups.size(); ++i, ++keyboard_group_it)
@@ -56,5 +168,8 @@ void save_settings(const Settings & settings)
     }
     qsettings.endArray();
 
+    qsettings.setValue(
+        "layout_backend",
+        settings.layout_backend == LayoutBackendType::XkbSwitch ? "xkbswitch" : "native");
     qsettings.setValue("xkbswitchlib_path", QString(settings.xkbswitchlib_path.string().c_str()));
 }
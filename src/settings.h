@@ -2,17 +2,51 @@
 
 #pragma once
 
+#include "endpoint.h"
+#include "receive_batch.h"
+#include "transport.h"
+
 #include <filesystem>
 #include <map>
 #include <string>
+#include <vector>
+
+enum class LayoutBackendType
+{
+    Native,
+    XkbSwitch
+};
 
 struct Settings
 {
     std::string receiver_host;
     std::string receiver_port;
+    // Where the transmitter sends group changes; receiver_host:receiver_port if empty.
+    std::vector<Endpoint> receivers;
+    TransportOptions transport;
+    // Request acks and retransmit unacknowledged layout updates.
+    bool reliable_delivery = false;
+    // Mark sent updates as carrying their capture time, so that receivers can trace latencies.
+    bool trace_latency = false;
+    ReceiveBackend receive_backend = ReceiveBackend::Socket;
+    // Group changes closer together than this are coalesced into the first and the last one; 0
+    // sends every change.
+    int coalescing_window_ms = 0;
+    // "host:port" or a "unix:" socket to serve Prometheus metrics on; off if empty.
+    std::string metrics_address;
     std::map<std::string, std::string> keyboard_groups;
+    LayoutBackendType layout_backend = LayoutBackendType::Native;
     std::filesystem::path xkbswitchlib_path;
 };
 
+// Destinations of the transmitter: the multicast group or broadcast address in those modes,
+// otherwise the receivers list.
+std::vector<Endpoint> transmit_endpoints(const Settings & settings);
+
+// The ini file settings are saved to.
+std::filesystem::path settings_path();
+
 Settings load_settings();
+// Reads an ini file written by save_settings() from another location.
+Settings load_settings(const std::filesystem::path & path);
 void save_settings(const Settings & settings);
@@ -41,12 +41,106 @@ SettingsWindow::SettingsWindow(OnSettingsChanged on_settings_changed)
 
         glayout->addWidget(new QLabel("Receiver host"), 0, 0);
         receiver_host_line_edit_ = new QLineEdit(settings.receiver_host.c_str());
+        receiver_host_line_edit_->setToolTip("Address, or unix:/path or unix:@name for a local socket");
         glayout->addWidget(receiver_host_line_edit_, 0, 1);
         glayout->addWidget(new QLabel("Receiver port"), 1, 0);
         receiver_port_line_edit_ = new QLineEdit(settings.receiver_port.c_str());
         glayout->addWidget(receiver_port_line_edit_, 1, 1);
     }
 
+    {
+        QGridLayout * const glayout = new QGridLayout();
+        QWidget * const glayout_widget = new QWidget();
+
+        glayout_widget->setLayout(glayout);
+        vlayout->addWidget(glayout_widget);
+
+        glayout->addWidget(new QLabel("Transmit to (receiver host and port if empty)"), 0, 0, 1, 4);
+
+        receivers_list_widget_ = new QListWidget();
+        glayout->addWidget(receivers_list_widget_, 1, 0, 1, 4);
+
+        for (const Endpoint & receiver : settings.receivers)
+        {
+            receivers_list_widget_->addItem(QString(to_string(receiver).c_str()));
+        }
+
+        glayout->addWidget(new QLabel("Host:port"), 2, 0);
+        receiver_line_edit_ = new QLineEdit();
+        receiver_line_edit_->setPlaceholderText("host:port, unix:/path or unix:@name");
+        glayout->addWidget(receiver_line_edit_, 2, 1);
+
+        QPushButton * add_button = new QPushButton("Add");
+        connect(add_button, &QPushButton::clicked, this, &SettingsWindow::on_add_receiver);
+        glayout->addWidget(add_button, 2, 2);
+
+        QPushButton * remove_button = new QPushButton("Remove");
+        connect(remove_button, &QPushButton::clicked, this, &SettingsWindow::on_remove_receiver);
+        glayout->addWidget(remove_button, 2, 3);
+    }
+
+    {
+        QGridLayout * const glayout = new QGridLayout();
+        QWidget * const glayout_widget = new QWidget();
+
+        glayout_widget->setLayout(glayout);
+        vlayout->addWidget(glayout_widget);
+
+        glayout->addWidget(new QLabel("Transport"), 0, 0);
+        transport_mode_combo_box_ = new QComboBox();
+        transport_mode_combo_box_->addItem("Unicast", static_cast<int>(TransportMode::Unicast));
+        transport_mode_combo_box_->addItem("Multicast", static_cast<int>(TransportMode::Multicast));
+        transport_mode_combo_box_->addItem("Broadcast", static_cast<int>(TransportMode::Broadcast));
+        transport_mode_combo_box_->setCurrentIndex(
+            transport_mode_combo_box_->findData(static_cast<int>(settings.transport.mode)));
+        glayout->addWidget(transport_mode_combo_box_, 0, 1);
+
+        glayout->addWidget(new QLabel("Multicast group"), 1, 0);
+        multicast_group_line_edit_ = new QLineEdit(settings.transport.multicast_group.c_str());
+        glayout->addWidget(multicast_group_line_edit_, 1, 1);
+        glayout->addWidget(new QLabel("Multicast TTL"), 2, 0);
+        multicast_ttl_spin_box_ = new QSpinBox();
+        multicast_ttl_spin_box_->setRange(1, 255);
+        multicast_ttl_spin_box_->setValue(settings.transport.multicast_ttl);
+        glayout->addWidget(multicast_ttl_spin_box_, 2, 1);
+        glayout->addWidget(new QLabel("Multicast interface"), 3, 0);
+        multicast_interface_line_edit_ = new QLineEdit(settings.transport.multicast_interface.c_str());
+        multicast_interface_line_edit_->setPlaceholderText("default");
+        glayout->addWidget(multicast_interface_line_edit_, 3, 1);
+        glayout->addWidget(new QLabel("Broadcast address"), 4, 0);
+        broadcast_address_line_edit_ = new QLineEdit(settings.transport.broadcast_address.c_str());
+        glayout->addWidget(broadcast_address_line_edit_, 4, 1);
+
+        reliable_delivery_check_box_ = new QCheckBox("Acknowledge and retransmit updates");
+        reliable_delivery_check_box_->setChecked(settings.reliable_delivery);
+        glayout->addWidget(reliable_delivery_check_box_, 5, 0, 1, 2);
+
+        trace_latency_check_box_ = new QCheckBox("Stamp updates for latency tracing");
+        trace_latency_check_box_->setChecked(settings.trace_latency);
+        glayout->addWidget(trace_latency_check_box_, 6, 0, 1, 2);
+
+        glayout->addWidget(new QLabel("Receive with"), 7, 0);
+        receive_backend_combo_box_ = new QComboBox();
+        receive_backend_combo_box_->addItem("recvmmsg()", static_cast<int>(ReceiveBackend::Socket));
+        receive_backend_combo_box_->addItem("io_uring", static_cast<int>(ReceiveBackend::IoUring));
+        receive_backend_combo_box_->setCurrentIndex(
+            receive_backend_combo_box_->findData(static_cast<int>(settings.receive_backend)));
+        glayout->addWidget(receive_backend_combo_box_, 7, 1);
+
+        glayout->addWidget(new QLabel("Coalesce group changes within"), 8, 0);
+        coalescing_window_spin_box_ = new QSpinBox();
+        coalescing_window_spin_box_->setRange(0, 2000);
+        coalescing_window_spin_box_->setSuffix(" ms");
+        coalescing_window_spin_box_->setSpecialValueText("off");
+        coalescing_window_spin_box_->setValue(settings.coalescing_window_ms);
+        glayout->addWidget(coalescing_window_spin_box_, 8, 1);
+
+        glayout->addWidget(new QLabel("Serve metrics on"), 9, 0);
+        metrics_address_line_edit_ = new QLineEdit(settings.metrics_address.c_str());
+        metrics_address_line_edit_->setPlaceholderText("off, e.g. 127.0.0.1:9436 or unix:/path");
+        glayout->addWidget(metrics_address_line_edit_, 9, 1);
+    }
+
     {
         QGridLayout * const glayout = new QGridLayout();
         QWidget * const glayout_widget = new QWidget();
@@ -87,13 +181,21 @@ SettingsWindow::SettingsWindow(OnSettingsChanged on_settings_changed)
         glayout_widget->setLayout(glayout);
         vlayout->addWidget(glayout_widget);
 
-        glayout->addWidget(new QLabel("XkbSwitch library location"), 0, 0, 1, 2);
+        glayout->addWidget(new QLabel("Layout backend"), 0, 0);
+        layout_backend_combo_box_ = new QComboBox();
+        layout_backend_combo_box_->addItem("Native XKB", static_cast<int>(LayoutBackendType::Native));
+        layout_backend_combo_box_->addItem("libxkbswitch", static_cast<int>(LayoutBackendType::XkbSwitch));
+        layout_backend_combo_box_->setCurrentIndex(
+            layout_backend_combo_box_->findData(static_cast<int>(settings.layout_backend)));
+        glayout->addWidget(layout_backend_combo_box_, 0, 1);
+
+        glayout->addWidget(new QLabel("XkbSwitch library location"), 1, 0, 1, 2);
         xkbswitchlib_path_line_edit_ = new QLineEdit(settings.xkbswitchlib_path.string().c_str());
-        glayout->addWidget(xkbswitchlib_path_line_edit_, 1, 0);
+        glayout->addWidget(xkbswitchlib_path_line_edit_, 2, 0);
 
         QPushButton * browse_button = new QPushButton("Browse");
         connect(browse_button, &QPushButton::clicked, this, &SettingsWindow::on_browse_for_xkbswitchlib);
-        glayout->addWidget(browse_button, 1, 1);
+        glayout->addWidget(browse_button, 2, 1);
     }
 
     QDialogButtonBox * const button_box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
@@ -112,6 +214,27 @@ void SettingsWindow::on_ok()
     settings.receiver_host = receiver_host_line_edit_->text().toStdString();
     settings.receiver_port = receiver_port_line_edit_->text().toStdString();
 
+    for (std::size_t row = 0; row < receivers_list_widget_->count(); ++row)
+    {
+        if (auto receiver = parse_endpoint(receivers_list_widget_->item(row)->text().toStdString()))
+        {
+            settings.receivers.push_back(std::move(*receiver));
+        }
+    }
+
+    settings.transport.mode =
+        static_cast<TransportMode>(transport_mode_combo_box_->currentData().toInt());
+    settings.transport.multicast_group = multicast_group_line_edit_->text().trimmed().toStdString();
+    settings.transport.multicast_ttl = multicast_ttl_spin_box_->value();
+    settings.transport.multicast_interface = multicast_interface_line_edit_->text().trimmed().toStdString();
+    settings.transport.broadcast_address = broadcast_address_line_edit_->text().trimmed().toStdString();
+    settings.reliable_delivery = reliable_delivery_check_box_->isChecked();
+    settings.trace_latency = trace_latency_check_box_->isChecked();
+    settings.receive_backend =
+        static_cast<ReceiveBackend>(receive_backend_combo_box_->currentData().toInt());
+    settings.coalescing_window_ms = coalescing_window_spin_box_->value();
+    settings.metrics_address = metrics_address_line_edit_->text().trimmed().toStdString();
+
     for (std::size_t row = 0; row < keyboard_groups_list_widget_->count(); ++row)
     {
         const QListWidgetItem * const item = keyboard_groups_list_widget_->item(row);
@@ -122,6 +245,8 @@ void SettingsWindow::on_ok()
         settings.keyboard_groups.emplace(std::move(local), std::move(remote));
     }
 
+    settings.layout_backend =
+        static_cast<LayoutBackendType>(layout_backend_combo_box_->currentData().toInt());
     settings.xkbswitchlib_path = xkbswitchlib_path_line_edit_->text().toStdString();
     save_settings(settings);
     on_settings_changed_(settings);
@@ -134,6 +259,25 @@ void SettingsWindow::on_cancel()
     reject();
 }
 
+void SettingsWindow::on_add_receiver()
+{
+    const std::string text = receiver_line_edit_->text().trimmed().toStdString();
+
+    if (const auto receiver = parse_endpoint(text))
+    {
+        receivers_list_widget_->addItem(QString(to_string(*receiver).c_str()));
+        receiver_line_edit_->clear();
+    }
+}
+
+void SettingsWindow::on_remove_receiver()
+{
+    if (QListWidgetItem * const item = receivers_list_widget_->currentItem())
+    {
+        receivers_list_widget_->takeItem(receivers_list_widget_->row(item));
+    }
+}
+
 void SettingsWindow::on_add_keyboard_group()
 {
     const auto local = keyboard_group_local_line_edit_->text();
@@ -4,9 +4,12 @@
 
 #include "settings.h"
 
+#include <QCheckBox>
+#include <QComboBox>
 #include <QDialog>
 #include <QLineEdit>
 #include <QListWidget>
+#include <QSpinBox>
 
 using OnSettingsChanged = std::function<void(const Settings &)>;
 
@@ -20,6 +23,8 @@ public:
 private:
     void on_ok();
     void on_cancel();
+    void on_add_receiver();
+    void on_remove_receiver();
     void on_add_keyboard_group();
     void on_remove_keyboard_group();
     void on_browse_for_xkbswitchlib();
@@ -28,8 +33,21 @@ private:
     const OnSettingsChanged on_settings_changed_;
     QLineEdit * receiver_host_line_edit_ = nullptr;
     QLineEdit * receiver_port_line_edit_ = nullptr;
+    QListWidget * receivers_list_widget_ = nullptr;
+    QLineEdit * receiver_line_edit_ = nullptr;
+    QComboBox * transport_mode_combo_box_ = nullptr;
+    QLineEdit * multicast_group_line_edit_ = nullptr;
+    QSpinBox * multicast_ttl_spin_box_ = nullptr;
+    QLineEdit * multicast_interface_line_edit_ = nullptr;
+    QLineEdit * broadcast_address_line_edit_ = nullptr;
+    QCheckBox * reliable_delivery_check_box_ = nullptr;
+    QCheckBox * trace_latency_check_box_ = nullptr;
+    QComboBox * receive_backend_combo_box_ = nullptr;
+    QSpinBox * coalescing_window_spin_box_ = nullptr;
+    QLineEdit * metrics_address_line_edit_ = nullptr;
     QListWidget * keyboard_groups_list_widget_ = nullptr;
     QLineEdit * keyboard_group_local_line_edit_ = nullptr;
     QLineEdit * keyboard_group_remote_line_edit_ = nullptr;
+    QComboBox * layout_backend_combo_box_ = nullptr;
     QLineEdit * xkbswitchlib_path_line_edit_ = nullptr;
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+//
+// When the ring is full, push() does not block or fail: the value goes to a single overflow slot
+// that keeps only the latest value, and later pushes keep overwriting it until the consumer has
+// taken it. pop() returns ring values first, then the overflow value, so values still come out
+// in order with only intermediate ones dropped.
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    // Producer side. Returns false if the value replaced an overflow value the consumer had not
+    // taken yet, i.e. if an update was dropped.
+    bool push(const T & value)
+    {
+        const std::uint32_t sequence = overflow_sequence_.load(std::memory_order_relaxed);
+        const bool overflow_pending = sequence != consumed_sequence_.load(std::memory_order_acquire);
+
+        if (!overflow_pending)
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+
+            if (tail - head_.load(std::memory_order_acquire) < Capacity)
+            {
+                ring_[tail & (Capacity - 1)] = value;
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+        }
+
+        store_overflow(value);
+        return !overflow_pending;
+    }
+
+    // Consumer side.
+    bool pop(T & value)
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head != tail_.load(std::memory_order_acquire))
+        {
+            value = ring_[head & (Capacity - 1)];
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        const std::uint32_t sequence = overflow_sequence_.load(std::memory_order_acquire);
+
+        // Nothing new, or the producer is in the middle of a write; it notifies the consumer again
+        // once done.
+        if (sequence == consumed_sequence_.load(std::memory_order_relaxed) || (sequence & 1) != 0)
+        {
+            return false;
+        }
+
+        if (!load_overflow(sequence, value))
+        {
+            return false;
+        }
+
+        // If the producer overwrote the slot after the load, the sequences still differ and the
+        // next pop() returns the newer value.
+        consumed_sequence_.store(sequence, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr std::size_t words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    // Seqlock over relaxed atomic words: the producer is the only writer.
+    void store_overflow(const T & value)
+    {
+        std::array<std::uint64_t, words> buffer{};
+        std::memcpy(buffer.data(), &value, sizeof(T));
+
+        const std::uint32_t sequence = overflow_sequence_.load(std::memory_order_relaxed);
+        overflow_sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            overflow_[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        overflow_sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool load_overflow(const std::uint32_t sequence, T & value) const
+    {
+        std::array<std::uint64_t, words> buffer;
+
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            buffer[i] = overflow_[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (overflow_sequence_.load(std::memory_order_relaxed) != sequence)
+        {
+            return false;
+        }
+
+        std::memcpy(&value, buffer.data(), sizeof(T));
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::array<T, Capacity> ring_;
+    // Even while the overflow slot is stable; it holds an unconsumed value while the sequences differ.
+    alignas(64) std::atomic<std::uint32_t> overflow_sequence_{0};
+    std::atomic<std::uint32_t> consumed_sequence_{0};
+    std::array<std::atomic<std::uint64_t>, words> overflow_{};
+};
@@ -0,0 +1,204 @@
+#include "transmit_stage.h"
+#include "resolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+
+#include <QScopeGuard>
+
+#include <errno.h>
+#include <poll.h>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+constexpr auto resolve_ttl = 60s;
+constexpr std::chrono::milliseconds heartbeat_min_interval = 1s;
+constexpr std::chrono::milliseconds heartbeat_max_interval = 64s;
+
+// The poll() timeout for the earlier of the transmitter's timeout and the next heartbeat.
+int poll_timeout(
+    const int transmitter_timeout_ms,
+    const std::optional<std::chrono::steady_clock::time_point> heartbeat_at)
+{
+    if (!heartbeat_at)
+    {
+        return transmitter_timeout_ms;
+    }
+
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+        *heartbeat_at - std::chrono::steady_clock::now()).count();
+    const int heartbeat_timeout_ms = std::max<decltype(remaining)>(remaining, 0);
+
+    return transmitter_timeout_ms < 0
+        ? heartbeat_timeout_ms
+        : std::min(transmitter_timeout_ms, heartbeat_timeout_ms);
+}
+
+}
+
+TransmitStage::TransmitStage(
+    const std::vector<Endpoint> & receivers,
+    const TransportOptions & transport,
+    const bool reliable,
+    const bool trace_latency,
+    const std::map<std::string, std::string> & keyboard_groups,
+    std::shared_ptr<PeerState> peer_state)
+    : receivers_{receivers}
+    , transport_{transport}
+    , reliable_{reliable}
+    , trace_latency_{trace_latency}
+    , peer_state_{std::move(peer_state)}
+    , routes_{std::make_shared<const GroupRoutes>(keyboard_groups)}
+{
+}
+
+void TransmitStage::post(const GroupChange & change)
+{
+    if (!queue_.push(change))
+    {
+        dropped_changes_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    queue_wakeup_.notify();
+}
+
+void TransmitStage::set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups)
+{
+    std::atomic_store(&routes_, std::make_shared<const GroupRoutes>(keyboard_groups));
+}
+
+void TransmitStage::run()
+{
+    Transmitter transmitter(
+        transport_,
+        reliable_,
+        transmitter_stats_,
+        peer_state_ ? peer_state_->origin() : protocol::random_origin());
+
+    // Resolution runs in the background; changes are picked up on the next queue wakeup.
+    Resolver resolver(receivers_, resolve_ttl, [this] { queue_wakeup_.notify(); });
+    std::shared_ptr<const ResolvedEndpoints> resolved;
+    resolver.start();
+
+    const auto resolver_guard = qScopeGuard([&]
+    {
+        resolver.stop();
+    });
+
+    const auto transmitter_fds = transmitter.fds();
+    struct pollfd poll_fds[] = {
+        {queue_wakeup_.fd(), POLLIN, 0},
+        {wakeup_fd(), POLLIN, 0},
+        {transmitter_fds[0], POLLIN, 0},
+        {transmitter_fds[1], POLLIN, 0},
+        {transmitter_fds[2], POLLIN, 0}};
+
+    // Unset until the first layout is sent.
+    std::optional<std::chrono::steady_clock::time_point> heartbeat_at;
+    std::chrono::milliseconds heartbeat_interval = heartbeat_min_interval;
+
+    while (true)
+    {
+        const int timeout_ms = poll_timeout(transmitter.timeout_ms(), heartbeat_at);
+
+        if (::poll(poll_fds, std::size(poll_fds), timeout_ms) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll()");
+        }
+
+        if (should_stop())
+        {
+            break;
+        }
+
+        if ((poll_fds[0].revents & POLLIN) != 0)
+        {
+            // Drain before popping so that a change posted meanwhile leaves the pipe readable.
+            queue_wakeup_.drain();
+
+            if (const auto latest_resolved = resolver.resolved(); latest_resolved != resolved)
+            {
+                resolved = latest_resolved;
+                transmitter.set_destinations(*resolved);
+            }
+
+            std::optional<GroupChange> latest;
+            GroupChange change;
+
+            while (queue_.pop(change))
+            {
+                latest = change;
+            }
+
+            if (latest)
+            {
+                const auto routes = std::atomic_load(&routes_);
+
+                if (const EncodedLayout * const layout = routes->find(latest->group))
+                {
+                    // In peer mode, echoes of layouts just applied from a peer end here.
+                    const std::optional<std::uint64_t> timestamp_us = peer_state_
+                        ? peer_state_->on_local_change(layout->layout(), latest->timestamp_us)
+                        : std::optional<std::uint64_t>{latest->timestamp_us};
+
+                    // Peer versioning may have moved the timestamp past the capture time.
+                    const bool traced = trace_latency_ && timestamp_us == latest->timestamp_us;
+
+                    if (timestamp_us)
+                    {
+                        transmitter.send(
+                            *layout,
+                            *timestamp_us,
+                            traced ? protocol::flag_capture_timestamp : 0);
+
+                        // A change restarts the backoff.
+                        heartbeat_interval = heartbeat_min_interval;
+                        heartbeat_at = std::chrono::steady_clock::now() + heartbeat_interval;
+                    }
+                }
+            }
+        }
+
+        for (std::size_t i = 2; i < std::size(poll_fds); ++i)
+        {
+            if ((poll_fds[i].revents & POLLIN) != 0)
+            {
+                transmitter.on_readable(poll_fds[i].fd);
+            }
+        }
+
+        transmitter.on_timer();
+
+        if (heartbeat_at && std::chrono::steady_clock::now() >= *heartbeat_at)
+        {
+            if (transmitter.send_heartbeat())
+            {
+                heartbeats_sent_.fetch_add(1, std::memory_order_relaxed);
+                heartbeat_interval = std::min(heartbeat_interval * 2, heartbeat_max_interval);
+            }
+
+            heartbeat_at = std::chrono::steady_clock::now() + heartbeat_interval;
+        }
+    }
+}
+
+const TransmitterStats & TransmitStage::transmitter_stats() const
+{
+    return transmitter_stats_;
+}
+
+std::uint64_t TransmitStage::heartbeats_sent() const
+{
+    return heartbeats_sent_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t TransmitStage::dropped_changes() const
+{
+    return dropped_changes_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "endpoint.h"
+#include "peer_state.h"
+#include "routing.h"
+#include "spsc_queue.h"
+#include "transmitter.h"
+#include "transport.h"
+#include "wakeup.h"
+#include "worker.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct GroupChange
+{
+    std::int32_t group;
+    std::uint64_t timestamp_us;
+};
+
+// Network half of the transmitter. The X capture thread hands group changes over through a
+// lock-free queue with post(), which never blocks; this worker maps them to layouts and sends
+// them, so a slow network cannot back up the X connection. If the queue overflows, only the
+// latest change is kept. With a PeerState, changes are versioned by it and echoes of layouts
+// received from peers are not sent. With trace_latency, packets are marked as carrying their
+// capture time. While nothing changes, the newest layout is repeated as a heartbeat, first after a
+// second and then at doubling intervals up to about a minute, so that receivers which started late
+// or lost a packet catch up without a steady stream of traffic.
+class TransmitStage : public Worker
+{
+public:
+    TransmitStage(
+        const std::vector<Endpoint> & receivers,
+        const TransportOptions & transport,
+        bool reliable,
+        bool trace_latency,
+        const std::map<std::string, std::string> & keyboard_groups,
+        std::shared_ptr<PeerState> peer_state = nullptr);
+
+    void post(const GroupChange & change);
+
+    // Compiles the mapping into GroupRoutes; takes effect with the next change and is safe to call
+    // while running.
+    void set_keyboard_groups(const std::map<std::string, std::string> & keyboard_groups);
+
+    const TransmitterStats & transmitter_stats() const;
+    // Group changes that were dropped because the queue was full.
+    std::uint64_t dropped_changes() const;
+    std::uint64_t heartbeats_sent() const;
+
+protected:
+    void run() override;
+
+private:
+    const std::vector<Endpoint> receivers_;
+    const TransportOptions transport_;
+    const bool reliable_;
+    const bool trace_latency_;
+    const std::shared_ptr<PeerState> peer_state_;
+    std::shared_ptr<const GroupRoutes> routes_;
+    SpscQueue<GroupChange, 64> queue_;
+    Wakeup queue_wakeup_;
+    TransmitterStats transmitter_stats_;
+    std::atomic<std::uint64_t> dropped_changes_{0};
+    std::atomic<std::uint64_t> heartbeats_sent_{0};
+};
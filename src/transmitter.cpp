@@ -0,0 +1,469 @@
+#include "transmitter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+constexpr std::chrono::microseconds initial_rto = 200ms;
+constexpr std::chrono::microseconds min_rto = 5ms;
+constexpr std::chrono::microseconds max_rto = 2s;
+constexpr int max_attempts = 8;
+
+constexpr std::array<int, 3> families = {AF_INET, AF_INET6, AF_UNIX};
+
+}
+
+Transmitter::Transmitter(
+    const TransportOptions & transport,
+    const bool reliable,
+    TransmitterStats & stats,
+    const std::uint32_t origin)
+    : transport_{transport}
+    , reliable_{reliable}
+    , stats_{stats}
+    , origin_{origin}
+{
+    try
+    {
+        for (std::size_t i = 0; i < families.size(); ++i)
+        {
+            fds_[i] = ::socket(families[i], SOCK_DGRAM, 0);
+
+            if (fds_[i] < 0)
+            {
+                // Hosts without IPv6 support only get an IPv4 socket, and vice versa.
+                if (errno == EAFNOSUPPORT)
+                {
+                    continue;
+                }
+
+                throw std::runtime_error("socket()");
+            }
+
+            if (families[i] == AF_UNIX)
+            {
+#ifdef __linux__
+                // An unbound AF_UNIX socket has no address to send acks to; binding just the family
+                // picks a unique abstract name.
+                const sa_family_t family = AF_UNIX;
+                const auto * const address = reinterpret_cast<const struct sockaddr *>(&family);
+
+                if (::bind(fds_[i], address, sizeof(family)) != 0)
+                {
+                    throw std::runtime_error("bind()");
+                }
+#endif
+                continue;
+            }
+
+            configure_sender_socket(fds_[i], families[i], transport_);
+        }
+
+        if (std::all_of(fds_.begin(), fds_.end(), [](const int fd) { return fd < 0; }))
+        {
+            throw std::runtime_error("socket()");
+        }
+    }
+    catch (...)
+    {
+        for (const int fd : fds_)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+
+        throw;
+    }
+}
+
+Transmitter::~Transmitter()
+{
+    for (const int fd : fds_)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+std::array<int, 3> Transmitter::fds() const
+{
+    return fds_;
+}
+
+int Transmitter::socket_for(const int family) const
+{
+    const auto it = std::find(families.begin(), families.end(), family);
+    return it != families.end() ? fds_[it - families.begin()] : -1;
+}
+
+void Transmitter::set_destinations(const ResolvedEndpoints & resolved)
+{
+    std::vector<Destination> destinations;
+    const auto now = Clock::now();
+
+    for (std::size_t i = 0; i < resolved.size(); ++i)
+    {
+        // Addresses come sorted by preference. The first one of every family there is a socket for
+        // gets a copy: a dual-stack name such as localhost often resolves to ::1 first, while the
+        // receiver may listen on IPv4 only. A receiver that gets both drops the second as stale.
+        for (const struct sockaddr_storage & address : resolved[i])
+        {
+            const int fd = socket_for(address.ss_family);
+
+            if (fd < 0 || std::any_of(
+                destinations.begin(),
+                destinations.end(),
+                [&](const Destination & destination)
+                {
+                    return destination.receiver == i && destination.fd == fd;
+                }))
+            {
+                continue;
+            }
+
+            const auto previous = std::find_if(
+                destinations_.begin(),
+                destinations_.end(),
+                [&](const Destination & destination)
+                {
+                    return destination.receiver == i && same_address(destination.address, address);
+                });
+
+            if (previous != destinations_.end())
+            {
+                // Keep the RTT estimate and retransmission state of unchanged receivers.
+                destinations.push_back(*previous);
+                continue;
+            }
+
+            Destination & destination = destinations.emplace_back();
+            destination.address = address;
+            destination.fd = fd;
+            destination.receiver = i;
+            destination.rto = initial_rto;
+
+            if (packet_size_ != 0)
+            {
+                send_one(destination, packet_.data());
+                mark_pending(destination, now);
+            }
+        }
+    }
+
+    destinations_ = std::move(destinations);
+
+#ifdef __linux__
+    for (std::size_t family = 0; family < families.size(); ++family)
+    {
+        headers_[family].clear();
+
+        for (Destination & destination : destinations_)
+        {
+            if (destination.fd >= 0 && destination.fd == fds_[family])
+            {
+                struct mmsghdr header = {};
+                header.msg_hdr.msg_name = &destination.address;
+                header.msg_hdr.msg_namelen = address_size(destination.address);
+                header.msg_hdr.msg_iov = &iovec_;
+                header.msg_hdr.msg_iovlen = 1;
+                headers_[family].push_back(header);
+            }
+        }
+    }
+#endif
+}
+
+void Transmitter::send(
+    const EncodedLayout & layout,
+    const std::uint64_t timestamp_us,
+    const std::uint8_t flags)
+{
+    if (layout.size == 0)
+    {
+        return;
+    }
+
+    std::copy_n(layout.packet.cbegin(), layout.size, packet_.begin());
+    packet_size_ = layout.size;
+    timestamp_us_ = timestamp_us;
+    protocol::stamp(
+        packet_.data(),
+        static_cast<std::uint8_t>(flags | (reliable_ ? protocol::flag_ack_requested : 0)),
+        origin_,
+        ++sequence_,
+        timestamp_us);
+
+    send_all(packet_.data());
+
+    // A newer layout supersedes whatever was still waiting for an ack.
+    const auto now = Clock::now();
+
+    for (Destination & destination : destinations_)
+    {
+        if (destination.fd >= 0)
+        {
+            mark_pending(destination, now);
+        }
+    }
+}
+
+bool Transmitter::send_heartbeat()
+{
+    if (packet_size_ == 0 || timeout_ms() >= 0)
+    {
+        return false;
+    }
+
+    // A new sequence number gets the heartbeat past the receivers' duplicate check; the original
+    // timestamp keeps peers from taking it for a newer change.
+    std::copy_n(packet_.cbegin(), packet_size_, heartbeat_.begin());
+    protocol::stamp(heartbeat_.data(), protocol::flag_heartbeat, origin_, ++sequence_, timestamp_us_);
+    send_all(heartbeat_.data());
+    return true;
+}
+
+void Transmitter::send_all(const char * const packet)
+{
+    iovec_ = {const_cast<char *>(packet), packet_size_};
+
+#ifdef __linux__
+    for (std::size_t family = 0; family < families.size(); ++family)
+    {
+        send_batch(fds_[family], headers_[family]);
+    }
+#else
+    for (Destination & destination : destinations_)
+    {
+        if (destination.fd >= 0)
+        {
+            send_one(destination, packet);
+        }
+    }
+#endif
+}
+
+#ifdef __linux__
+void Transmitter::send_batch(const int fd, std::vector<struct mmsghdr> & headers)
+{
+    // The sockets are not connected and sends do not block, so a receiver that is slow or
+    // unreachable only loses its own copy.
+    std::size_t next = 0;
+    int retries = 5;
+
+    while (next < headers.size())
+    {
+        const int sent = ::sendmmsg(fd, headers.data() + next, headers.size() - next, MSG_DONTWAIT);
+
+        if (sent > 0)
+        {
+            next += sent;
+            stats_.packets_sent.fetch_add(sent, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (errno == EINTR && retries-- > 0)
+        {
+            stats_.send_retries.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // The datagram for this destination could not be queued; skip it rather than hold up the
+        // remaining ones. In reliable mode it is retransmitted on timeout.
+        stats_.send_errors.fetch_add(1, std::memory_order_relaxed);
+        ++next;
+    }
+}
+#endif
+
+void Transmitter::send_one(Destination & destination, const char * const packet)
+{
+    const auto sent = ::sendto(
+        destination.fd,
+        packet,
+        packet_size_,
+        MSG_DONTWAIT,
+        reinterpret_cast<const struct sockaddr *>(&destination.address),
+        address_size(destination.address));
+
+    if (sent >= 0)
+    {
+        stats_.packets_sent.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        stats_.send_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Transmitter::mark_pending(Destination & destination, const Clock::time_point now)
+{
+    if (!reliable_)
+    {
+        return;
+    }
+
+    destination.pending = true;
+    destination.sequence = sequence_;
+    destination.attempts = 1;
+    destination.sent_at = now;
+    destination.deadline = now + destination.rto;
+}
+
+void Transmitter::on_readable(const int fd)
+{
+    std::array<char, protocol::max_packet_size> buffer;
+    const auto now = Clock::now();
+
+    while (true)
+    {
+        struct sockaddr_storage sender = {};
+        socklen_t sender_size = sizeof(sender);
+
+        const auto packet_size = ::recvfrom(
+            fd,
+            buffer.data(),
+            buffer.size(),
+            MSG_DONTWAIT,
+            reinterpret_cast<struct sockaddr *>(&sender),
+            &sender_size);
+
+        if (packet_size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // EAGAIN once drained; ICMP errors such as ECONNREFUSED are reported here as well and
+            // are left to the retransmit timer.
+            break;
+        }
+
+        const auto message = protocol::parse(buffer.data(), packet_size);
+
+        if (!message || message->type != protocol::MessageType::Ack || message->origin != origin_)
+        {
+            continue;
+        }
+
+        stats_.acks_received.fetch_add(1, std::memory_order_relaxed);
+
+        // A multicast or broadcast packet is answered from unicast addresses; any receiver's ack
+        // settles the single group destination.
+        for (Destination & destination : destinations_)
+        {
+            if (transport_.mode != TransportMode::Unicast || same_address(destination.address, sender))
+            {
+                on_ack(destination, message->sequence, now);
+
+                // The receiver has the packet, so its addresses in other families stop waiting.
+                for (Destination & sibling : destinations_)
+                {
+                    if (sibling.receiver == destination.receiver
+                        && sibling.pending
+                        && sibling.sequence == message->sequence)
+                    {
+                        sibling.pending = false;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Transmitter::on_ack(
+    Destination & destination,
+    const std::uint32_t sequence,
+    const Clock::time_point now)
+{
+    if (!destination.pending || destination.sequence != sequence)
+    {
+        return;
+    }
+
+    destination.pending = false;
+
+    // Karn's algorithm: an ack for a retransmitted packet cannot be matched to one transmission.
+    if (destination.attempts != 1)
+    {
+        return;
+    }
+
+    // RFC 6298 estimator.
+    const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(now - destination.sent_at);
+
+    if (destination.srtt.count() == 0)
+    {
+        destination.srtt = rtt;
+        destination.rttvar = rtt / 2;
+    }
+    else
+    {
+        const auto delta = destination.srtt > rtt ? destination.srtt - rtt : rtt - destination.srtt;
+        destination.rttvar = (3 * destination.rttvar + delta) / 4;
+        destination.srtt = (7 * destination.srtt + rtt) / 8;
+    }
+
+    destination.rto = std::clamp(destination.srtt + 4 * destination.rttvar, min_rto, max_rto);
+    stats_.rtt_us.store(destination.srtt.count(), std::memory_order_relaxed);
+}
+
+void Transmitter::on_timer()
+{
+    const auto now = Clock::now();
+
+    for (Destination & destination : destinations_)
+    {
+        if (!destination.pending || destination.deadline > now)
+        {
+            continue;
+        }
+
+        if (destination.attempts >= max_attempts)
+        {
+            destination.pending = false;
+            continue;
+        }
+
+        send_one(destination, packet_.data());
+
+        ++destination.attempts;
+        destination.rto = std::min(destination.rto * 2, max_rto);
+        destination.deadline = now + destination.rto;
+        stats_.retransmits.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int Transmitter::timeout_ms() const
+{
+    const auto now = Clock::now();
+    int timeout = -1;
+
+    for (const Destination & destination : destinations_)
+    {
+        if (!destination.pending)
+        {
+            continue;
+        }
+
+        const auto remaining =
+            std::chrono::ceil<std::chrono::milliseconds>(destination.deadline - now).count();
+        const int remaining_ms = std::max<decltype(remaining)>(remaining, 0);
+        timeout = timeout < 0 ? remaining_ms : std::min(timeout, remaining_ms);
+    }
+
+    return timeout;
+}
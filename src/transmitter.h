@@ -0,0 +1,116 @@
+#pragma once
+
+#include "protocol.h"
+#include "resolver.h"
+#include "routing.h"
+#include "transport.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+struct TransmitterStats
+{
+    std::atomic<std::uint64_t> packets_sent{0};
+    std::atomic<std::uint64_t> retransmits{0};
+    std::atomic<std::uint64_t> acks_received{0};
+    // Sends repeated after an interruption, and datagrams given up on because they could not be
+    // queued.
+    std::atomic<std::uint64_t> send_retries{0};
+    std::atomic<std::uint64_t> send_errors{0};
+    // Smoothed round-trip time of acknowledged packets; 0 until the first ack.
+    std::atomic<std::int64_t> rtt_us{0};
+};
+
+// Sends layout updates to all receivers over IPv4, IPv6 and AF_UNIX datagram sockets. In reliable
+// mode every packet requests an ack and is retransmitted with an RTT-based timeout until
+// acknowledged; only the newest layout is ever retransmitted. Nothing here blocks: the owner polls
+// fds() and calls on_readable() and on_timer(), waiting at most timeout_ms() in between.
+class Transmitter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Transmitter(
+        const TransportOptions & transport,
+        bool reliable,
+        TransmitterStats & stats,
+        std::uint32_t origin = protocol::random_origin());
+    ~Transmitter();
+
+    Transmitter(const Transmitter &) = delete;
+    Transmitter & operator=(const Transmitter &) = delete;
+
+    // IPv4, IPv6 and AF_UNIX sockets; -1 if the family is not available, which poll() ignores.
+    std::array<int, 3> fds() const;
+
+    // Takes the addresses of the receivers, one entry per receiver. Receivers that were not known
+    // before get the newest layout right away, so that updates sent before DNS answered are not
+    // lost.
+    void set_destinations(const ResolvedEndpoints & resolved);
+
+    // timestamp_us is when the change was captured, see protocol::now_us(). flags are added to the
+    // ones the transmitter sets itself.
+    void send(const EncodedLayout & layout, std::uint64_t timestamp_us, std::uint8_t flags = 0);
+    // Repeats the newest layout as a heartbeat to every receiver, without requesting acks. Returns
+    // false without sending if there is no layout yet or a retransmission is outstanding, which
+    // repairs receivers anyway.
+    bool send_heartbeat();
+    void on_readable(int fd);
+    void on_timer();
+
+    // Milliseconds until the next retransmission is due, or -1 if nothing is outstanding.
+    int timeout_ms() const;
+
+private:
+    struct Destination
+    {
+        struct sockaddr_storage address = {};
+        int fd = -1;
+        // Index of the receiver in the resolved endpoints; one receiver has a destination per
+        // address family.
+        std::size_t receiver = 0;
+        bool pending = false;
+        std::uint32_t sequence = 0;
+        int attempts = 0;
+        Clock::time_point sent_at;
+        Clock::time_point deadline;
+        std::chrono::microseconds srtt{0};
+        std::chrono::microseconds rttvar{0};
+        std::chrono::microseconds rto;
+    };
+
+    int socket_for(int family) const;
+    void send_all(const char * packet);
+#ifdef __linux__
+    void send_batch(int fd, std::vector<struct mmsghdr> & headers);
+#endif
+    void send_one(Destination & destination, const char * packet);
+    void mark_pending(Destination & destination, Clock::time_point now);
+    void on_ack(Destination & destination, std::uint32_t sequence, Clock::time_point now);
+
+private:
+    const TransportOptions transport_;
+    const bool reliable_;
+    TransmitterStats & stats_;
+    const std::uint32_t origin_;
+    std::array<int, 3> fds_ = {-1, -1, -1};
+    std::uint32_t sequence_ = 0;
+    std::vector<Destination> destinations_;
+    std::array<char, protocol::max_packet_size> packet_;
+    // A copy of packet_ restamped as a heartbeat; packet_ keeps the sequence that retransmissions
+    // and new destinations are acked with.
+    std::array<char, protocol::max_packet_size> heartbeat_;
+    std::size_t packet_size_ = 0;
+    std::uint64_t timestamp_us_ = 0;
+    struct iovec iovec_ = {};
+#ifdef __linux__
+    // sendmmsg() batches for each socket.
+    std::array<std::vector<struct mmsghdr>, 3> headers_;
+#endif
+};
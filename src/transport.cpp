@@ -0,0 +1,218 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "transport.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Accepts either a local IPv4 address or the name of an interface that has one.
+struct in_addr interface_address(const std::string & interface)
+{
+    struct in_addr address = {};
+    address.s_addr = htonl(INADDR_ANY);
+
+    if (interface.empty() || ::inet_pton(AF_INET, interface.c_str(), &address) == 1)
+    {
+        return address;
+    }
+
+    struct ifaddrs * interfaces = nullptr;
+
+    if (::getifaddrs(&interfaces) != 0)
+    {
+        throw std::runtime_error("getifaddrs()");
+    }
+
+    bool found = false;
+
+    for (const struct ifaddrs * it = interfaces; it != nullptr; it = it->ifa_next)
+    {
+        if (it->ifa_addr != nullptr && it->ifa_addr->sa_family == AF_INET
+            && interface == it->ifa_name)
+        {
+            address = reinterpret_cast<const struct sockaddr_in *>(it->ifa_addr)->sin_addr;
+            found = true;
+            break;
+        }
+    }
+
+    ::freeifaddrs(interfaces);
+
+    if (!found)
+    {
+        throw std::runtime_error("unknown multicast interface " + interface);
+    }
+
+    return address;
+}
+
+unsigned int interface_index(const std::string & interface)
+{
+    struct in_addr ipv4_address;
+
+    // An IPv4 interface address says nothing about IPv6; use the default interface then.
+    if (interface.empty() || ::inet_pton(AF_INET, interface.c_str(), &ipv4_address) == 1)
+    {
+        return 0;
+    }
+
+    const unsigned int index = ::if_nametoindex(interface.c_str());
+
+    if (index == 0)
+    {
+        throw std::runtime_error("if_nametoindex()");
+    }
+
+    return index;
+}
+
+}
+
+bool operator==(const TransportOptions & lhs, const TransportOptions & rhs)
+{
+    return lhs.mode == rhs.mode
+        && lhs.multicast_group == rhs.multicast_group
+        && lhs.multicast_ttl == rhs.multicast_ttl
+        && lhs.multicast_interface == rhs.multicast_interface
+        && lhs.broadcast_address == rhs.broadcast_address;
+}
+
+bool operator!=(const TransportOptions & lhs, const TransportOptions & rhs)
+{
+    return !(lhs == rhs);
+}
+
+void configure_sender_socket(const int fd, const int family, const TransportOptions & options)
+{
+    if (options.mode == TransportMode::Broadcast)
+    {
+        int sockopt = 1;
+        if (::setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &sockopt, sizeof(sockopt)) != 0)
+        {
+            throw std::runtime_error("setsockopt()");
+        }
+    }
+
+    if (options.mode != TransportMode::Multicast)
+    {
+        return;
+    }
+
+    // Looping multicast back to local sockets lets receivers on the same host, and tests on the
+    // loopback interface, see the packets.
+    if (family == AF_INET)
+    {
+        const unsigned char ttl = options.multicast_ttl;
+        const unsigned char loop = 1;
+        const struct in_addr interface = interface_address(options.multicast_interface);
+
+        if (::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0
+            || ::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0
+            || ::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) != 0)
+        {
+            throw std::runtime_error("setsockopt()");
+        }
+    }
+    else if (family == AF_INET6)
+    {
+        const int hops = options.multicast_ttl;
+        const unsigned int loop = 1;
+        const unsigned int interface = interface_index(options.multicast_interface);
+
+        if (::setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops)) != 0
+            || ::setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop)) != 0
+            || ::setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &interface, sizeof(interface)) != 0)
+        {
+            throw std::runtime_error("setsockopt()");
+        }
+    }
+}
+
+void join_multicast_group(const int fd, const struct sockaddr * const group, const std::string & interface)
+{
+    if (group->sa_family == AF_INET)
+    {
+        struct ip_mreq request = {};
+        request.imr_multiaddr = reinterpret_cast<const struct sockaddr_in *>(group)->sin_addr;
+        request.imr_interface = interface_address(interface);
+
+        if (::setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0)
+        {
+            throw std::runtime_error("setsockopt(IP_ADD_MEMBERSHIP)");
+        }
+    }
+    else if (group->sa_family == AF_INET6)
+    {
+        struct ipv6_mreq request = {};
+        request.ipv6mr_multiaddr = reinterpret_cast<const struct sockaddr_in6 *>(group)->sin6_addr;
+        request.ipv6mr_interface = interface_index(interface);
+
+        if (::setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &request, sizeof(request)) != 0)
+        {
+            throw std::runtime_error("setsockopt(IPV6_JOIN_GROUP)");
+        }
+    }
+}
+
+socklen_t make_unix_address(const std::string & name, struct sockaddr_storage & address)
+{
+    auto & unix_address = reinterpret_cast<struct sockaddr_un &>(address);
+
+    address = {};
+    unix_address.sun_family = AF_UNIX;
+
+    // Paths need room for the terminating NUL, abstract names do not have one.
+    if (name.empty() || name.size() >= sizeof(unix_address.sun_path))
+    {
+        return 0;
+    }
+
+    std::memcpy(unix_address.sun_path, name.data(), name.size());
+
+    if (name.front() != '@')
+    {
+        return offsetof(struct sockaddr_un, sun_path) + name.size() + 1;
+    }
+
+#ifdef __linux__
+    // The abstract namespace is marked by a leading NUL in place of the '@'.
+    unix_address.sun_path[0] = '\0';
+    return offsetof(struct sockaddr_un, sun_path) + name.size();
+#else
+    return 0;
+#endif
+}
+
+void bind_unix_socket(const int fd, const std::string & name)
+{
+    struct sockaddr_storage address;
+    const socklen_t address_size = make_unix_address(name, address);
+
+    if (address_size == 0)
+    {
+        throw std::runtime_error("invalid unix socket name " + name);
+    }
+
+    // A socket file left behind by a process that did not shut down would make bind() fail.
+    if (struct stat status; name.front() != '@' && ::lstat(name.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+    {
+        ::unlink(name.c_str());
+    }
+
+    if (::bind(fd, reinterpret_cast<const struct sockaddr *>(&address), address_size) != 0)
+    {
+        throw std::runtime_error("bind()");
+    }
+}
@@ -0,0 +1,41 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include <string>
+
+#include <sys/socket.h>
+
+enum class TransportMode
+{
+    Unicast,
+    Multicast,
+    Broadcast
+};
+
+struct TransportOptions
+{
+    TransportMode mode = TransportMode::Unicast;
+    std::string multicast_group = "239.255.36.32";
+    int multicast_ttl = 1;
+    // Interface name or local address used for multicast; the system default if empty.
+    std::string multicast_interface;
+    std::string broadcast_address = "255.255.255.255";
+};
+
+bool operator==(const TransportOptions & lhs, const TransportOptions & rhs);
+bool operator!=(const TransportOptions & lhs, const TransportOptions & rhs);
+
+// Prepares a sending socket of the given family for the selected transport mode.
+void configure_sender_socket(int fd, int family, const TransportOptions & options);
+
+// Joins the multicast group on a bound receiving socket.
+void join_multicast_group(int fd, const struct sockaddr * group, const std::string & interface);
+
+// Fills address for an AF_UNIX socket named by a path or, on Linux, "@name" in the abstract
+// namespace; returns the address size, or 0 if the name is empty or too long.
+socklen_t make_unix_address(const std::string & name, struct sockaddr_storage & address);
+
+// Binds fd to a name accepted by make_unix_address(), first removing a socket file left behind by
+// a process that did not shut down; throws on failure.
+void bind_unix_socket(int fd, const std::string & name);
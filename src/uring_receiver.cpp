@@ -0,0 +1,314 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#include "uring_receiver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr unsigned submission_entries = 4;
+constexpr unsigned completion_entries = 256;
+// Must be a power of two.
+constexpr unsigned buffer_count = 256;
+constexpr std::uint16_t buffer_group = 0;
+// The kernel writes the io_uring_recvmsg_out header and the sender address ahead of the payload.
+constexpr std::size_t buffer_stride =
+    sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage) + ReceiveBatch::buffer_size;
+
+std::runtime_error system_error(const std::string & what, const int error)
+{
+    return std::runtime_error(what + ": " + std::strerror(error));
+}
+
+template <typename T>
+T * at_offset(void * const base, const std::uint32_t offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+}
+
+UringReceiver::UringReceiver(const int socket_fd)
+    : socket_fd_{socket_fd}
+{
+    struct io_uring_params params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = completion_entries;
+
+    ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, submission_entries, &params));
+
+    if (ring_fd_ < 0)
+    {
+        throw system_error("io_uring_setup()", errno);
+    }
+
+    try
+    {
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+        {
+            throw std::runtime_error("io_uring without IORING_FEAT_SINGLE_MMAP");
+        }
+
+        ring_memory_size_ = std::max(
+            params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+            params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+        ring_memory_ = ::mmap(
+            nullptr,
+            ring_memory_size_,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ring_fd_,
+            IORING_OFF_SQ_RING);
+
+        if (ring_memory_ == MAP_FAILED)
+        {
+            ring_memory_ = nullptr;
+            throw system_error("mmap()", errno);
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        void * const sqes = ::mmap(
+            nullptr,
+            sqes_size_,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ring_fd_,
+            IORING_OFF_SQES);
+
+        if (sqes == MAP_FAILED)
+        {
+            throw system_error("mmap()", errno);
+        }
+
+        sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+        sq_head_ = at_offset<std::uint32_t>(ring_memory_, params.sq_off.head);
+        sq_tail_ = at_offset<std::uint32_t>(ring_memory_, params.sq_off.tail);
+        sq_mask_ = *at_offset<std::uint32_t>(ring_memory_, params.sq_off.ring_mask);
+        sq_array_ = at_offset<std::uint32_t>(ring_memory_, params.sq_off.array);
+        cq_head_ = at_offset<std::uint32_t>(ring_memory_, params.cq_off.head);
+        cq_tail_ = at_offset<std::uint32_t>(ring_memory_, params.cq_off.tail);
+        cq_mask_ = *at_offset<std::uint32_t>(ring_memory_, params.cq_off.ring_mask);
+        cqes_ = at_offset<struct io_uring_cqe>(ring_memory_, params.cq_off.cqes);
+
+        buffer_ring_size_ = buffer_count * sizeof(struct io_uring_buf);
+        void * const buffer_ring = ::mmap(
+            nullptr,
+            buffer_ring_size_,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+
+        if (buffer_ring == MAP_FAILED)
+        {
+            throw system_error("mmap()", errno);
+        }
+
+        buffer_ring_ = static_cast<struct io_uring_buf_ring *>(buffer_ring);
+
+        struct io_uring_buf_reg buffer_registration = {};
+        buffer_registration.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring_);
+        buffer_registration.ring_entries = buffer_count;
+        buffer_registration.bgid = buffer_group;
+
+        if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &buffer_registration, 1) != 0)
+        {
+            throw system_error("IORING_REGISTER_PBUF_RING", errno);
+        }
+
+        buffers_.resize(buffer_count * buffer_stride);
+
+        for (unsigned buffer_id = 0; buffer_id < buffer_count; ++buffer_id)
+        {
+            recycle(static_cast<std::uint16_t>(buffer_id));
+        }
+
+        message_header_.msg_namelen = sizeof(struct sockaddr_storage);
+        arm();
+
+        // Kernels without multishot receives reject the request while it is submitted, so the
+        // failure is already in the completion queue.
+        if (*cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe & cqe = cqes_[*cq_head_ & cq_mask_];
+
+            if (cqe.res < 0)
+            {
+                throw system_error("multishot IORING_OP_RECVMSG", -cqe.res);
+            }
+        }
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+UringReceiver::~UringReceiver()
+{
+    release();
+}
+
+int UringReceiver::fd() const
+{
+    return ring_fd_;
+}
+
+std::size_t UringReceiver::receive(ReceiveBatch & batch)
+{
+    std::uint32_t head = *cq_head_;
+    const std::uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    std::size_t count = 0;
+
+    for (; head != tail && count < ReceiveBatch::capacity; ++head)
+    {
+        const struct io_uring_cqe & cqe = cqes_[head & cq_mask_];
+
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0)
+        {
+            armed_ = false;
+        }
+
+        if (cqe.res < 0)
+        {
+            // Out of buffers: the receive ended and is re-armed once they are recycled below.
+            if (cqe.res == -ENOBUFS)
+            {
+                continue;
+            }
+
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            throw system_error("io_uring recvmsg", -cqe.res);
+        }
+
+        if ((cqe.flags & IORING_CQE_F_BUFFER) == 0)
+        {
+            continue;
+        }
+
+        const auto buffer_id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        const char * const buffer = buffers_.data() + buffer_id * buffer_stride;
+
+        struct io_uring_recvmsg_out out;
+        std::memcpy(&out, buffer, sizeof(out));
+
+        const char * const name = buffer + sizeof(out);
+        const char * const payload = name + message_header_.msg_namelen + message_header_.msg_controllen;
+        const std::size_t size = std::min<std::size_t>(out.payloadlen, ReceiveBatch::buffer_size);
+        const std::size_t name_size = std::min<std::size_t>(out.namelen, sizeof(struct sockaddr_storage));
+
+        std::memcpy(batch.buffers[count].data(), payload, size);
+        std::memcpy(&batch.senders[count], name, name_size);
+        batch.sizes[count] = size;
+        batch.sender_sizes[count] = static_cast<socklen_t>(name_size);
+        ++count;
+
+        recycle(buffer_id);
+    }
+
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+    if (!armed_)
+    {
+        arm();
+    }
+
+    return count;
+}
+
+std::uint64_t UringReceiver::syscalls() const
+{
+    return syscalls_;
+}
+
+void UringReceiver::arm()
+{
+    const std::uint32_t tail = *sq_tail_;
+    const std::uint32_t index = tail & sq_mask_;
+    struct io_uring_sqe & sqe = sqes_[index];
+
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_RECVMSG;
+    sqe.fd = socket_fd_;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&message_header_);
+    sqe.len = 1;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = buffer_group;
+
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    submit();
+    armed_ = true;
+}
+
+void UringReceiver::submit()
+{
+    while (true)
+    {
+        ++syscalls_;
+
+        if (::syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) >= 0)
+        {
+            return;
+        }
+
+        if (errno != EINTR)
+        {
+            throw system_error("io_uring_enter()", errno);
+        }
+    }
+}
+
+void UringReceiver::recycle(const std::uint16_t buffer_id)
+{
+    // Not buffer_ring_->bufs: the kernel header declares it through an empty struct, which moves it
+    // to offset 8 in C++.
+    struct io_uring_buf & buffer =
+        reinterpret_cast<struct io_uring_buf *>(buffer_ring_)[buffer_ring_tail_ & (buffer_count - 1)];
+    buffer.addr = reinterpret_cast<std::uint64_t>(buffers_.data() + buffer_id * buffer_stride);
+    buffer.len = buffer_stride;
+    buffer.bid = buffer_id;
+
+    ++buffer_ring_tail_;
+    __atomic_store_n(&buffer_ring_->tail, buffer_ring_tail_, __ATOMIC_RELEASE);
+}
+
+void UringReceiver::release()
+{
+    // Closing the ring cancels the pending receive before its buffers go away.
+    if (ring_fd_ >= 0)
+    {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+
+    if (buffer_ring_ != nullptr)
+    {
+        ::munmap(buffer_ring_, buffer_ring_size_);
+        buffer_ring_ = nullptr;
+    }
+
+    if (sqes_ != nullptr)
+    {
+        ::munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+
+    if (ring_memory_ != nullptr)
+    {
+        ::munmap(ring_memory_, ring_memory_size_);
+        ring_memory_ = nullptr;
+    }
+}
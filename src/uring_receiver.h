@@ -0,0 +1,69 @@
+// vi: ts=4 sw=4 tw=100 et
+
+#pragma once
+
+#include "receive_batch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+// Receives datagrams from one socket through io_uring: a single multishot IORING_OP_RECVMSG keeps
+// completing into a ring of provided buffers, so that the kernel delivers packets without a
+// receive syscall per wakeup. The ring fd becomes readable when completions are pending and is
+// watched by the reactor in place of the socket. Uses the raw syscalls, so no liburing is needed.
+class UringReceiver
+{
+public:
+    // Throws std::runtime_error if io_uring, provided buffer rings or multishot receives are not
+    // available, e.g. on kernels before 6.0 or where io_uring is disabled.
+    explicit UringReceiver(int socket_fd);
+    ~UringReceiver();
+
+    UringReceiver(const UringReceiver &) = delete;
+    UringReceiver & operator=(const UringReceiver &) = delete;
+
+    int fd() const;
+
+    // Copies completed datagrams into batch, up to its capacity, and returns how many; re-arms the
+    // receive if the kernel ended it.
+    std::size_t receive(ReceiveBatch & batch);
+
+    // io_uring_enter() calls made so far.
+    std::uint64_t syscalls() const;
+
+private:
+    void arm();
+    void submit();
+    void recycle(std::uint16_t buffer_id);
+    void release();
+
+private:
+    const int socket_fd_;
+    int ring_fd_ = -1;
+
+    void * ring_memory_ = nullptr;
+    std::size_t ring_memory_size_ = 0;
+    struct io_uring_sqe * sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    std::uint32_t * sq_head_ = nullptr;
+    std::uint32_t * sq_tail_ = nullptr;
+    std::uint32_t sq_mask_ = 0;
+    std::uint32_t * sq_array_ = nullptr;
+    std::uint32_t * cq_head_ = nullptr;
+    std::uint32_t * cq_tail_ = nullptr;
+    std::uint32_t cq_mask_ = 0;
+    struct io_uring_cqe * cqes_ = nullptr;
+
+    struct io_uring_buf_ring * buffer_ring_ = nullptr;
+    std::size_t buffer_ring_size_ = 0;
+    std::uint16_t buffer_ring_tail_ = 0;
+    std::vector<char> buffers_;
+
+    struct msghdr message_header_ = {};
+    bool armed_ = false;
+    std::uint64_t syscalls_ = 0;
+};
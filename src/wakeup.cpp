@@ -0,0 +1,60 @@
+#include "wakeup.h"
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+void set_flags(const int fd)
+{
+    if (::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) < 0
+        || ::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC) < 0)
+    {
+        throw std::runtime_error("fcntl()");
+    }
+}
+
+}
+
+Wakeup::Wakeup()
+{
+    if (::pipe(pipe_) != 0)
+    {
+        throw std::runtime_error("pipe()");
+    }
+
+    set_flags(pipe_[0]);
+    set_flags(pipe_[1]);
+}
+
+Wakeup::~Wakeup()
+{
+    ::close(pipe_[0]);
+    ::close(pipe_[1]);
+}
+
+int Wakeup::fd() const
+{
+    return pipe_[0];
+}
+
+void Wakeup::notify()
+{
+    // EAGAIN means the pipe is full, i.e. a wakeup is already pending.
+    const char byte = 0;
+    while (::write(pipe_[1], &byte, sizeof(byte)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+void Wakeup::drain()
+{
+    char buffer[64];
+    while (::read(pipe_[0], buffer, sizeof(buffer)) > 0)
+    {
+    }
+}
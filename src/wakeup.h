@@ -0,0 +1,19 @@
+#pragma once
+
+// A non-blocking self-pipe: notify() from any thread makes fd() readable until drain().
+class Wakeup
+{
+public:
+    Wakeup();
+    ~Wakeup();
+
+    Wakeup(const Wakeup &) = delete;
+    Wakeup & operator=(const Wakeup &) = delete;
+
+    int fd() const;
+    void notify();
+    void drain();
+
+private:
+    int pipe_[2] = {-1, -1};
+};
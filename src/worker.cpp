@@ -16,13 +16,16 @@ Worker::~Worker()
 void Worker::start()
 {
     Status stopped{Status::Stopped};
-    if (status_.compare_exchange_weak(stopped, Status::Running))
+    if (status_.compare_exchange_strong(stopped, Status::Running))
     {
         if (thread_.joinable())
         {
             thread_.join();
         }
 
+        wakeup_.drain();
+        starts_.fetch_add(1, std::memory_order_relaxed);
+
         thread_ = std::thread{[this] {
             try
             {
@@ -31,6 +34,7 @@ void Worker::start()
             catch (const std::exception & e)
             {
                 std::cerr << "Error: " << e.what() << std::endl;
+                failures_.fetch_add(1, std::memory_order_relaxed);
                 status_ = Status::Stopped;
             }
         }};
@@ -39,20 +43,50 @@ void Worker::start()
 
 void Worker::stop()
 {
-    Status running{Status::Running};
-    if (status_.compare_exchange_weak(running, Status::Stopping))
+    request_stop();
+
+    if (thread_.joinable())
     {
         thread_.join();
     }
 }
 
+void Worker::request_stop()
+{
+    Status running{Status::Running};
+    if (status_.compare_exchange_strong(running, Status::Stopping))
+    {
+        wakeup_.notify();
+    }
+}
+
 Status Worker::status() const
 {
     return status_;
 }
 
+std::uint64_t Worker::starts() const
+{
+    return starts_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Worker::failures() const
+{
+    return failures_.load(std::memory_order_relaxed);
+}
+
+bool Worker::running() const
+{
+    return status() == Status::Running;
+}
+
 bool Worker::should_stop()
 {
     Status stopping{Status::Stopping};
-    return status_.compare_exchange_weak(stopping, Status::Stopped);
+    return status_.compare_exchange_strong(stopping, Status::Stopped);
+}
+
+int Worker::wakeup_fd() const
+{
+    return wakeup_.fd();
 }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "status.h"
+#include "wakeup.h"
 
 #include <thread>
 #include <atomic>
+#include <cstdint>
 
 class Worker
 {
@@ -11,14 +13,32 @@ public:
     virtual ~Worker();
 
     virtual void start();
+    // Asks the thread to stop and waits for it to exit.
     virtual void stop();
+    // Asks the thread to stop without waiting; stop() or the destructor joins it later. start()
+    // does nothing until then.
+    void request_stop();
     virtual Status status() const;
+    // status() == Status::Running, for code that includes Xlib, whose Status macro hides the enum.
+    bool running() const;
+
+    // Times the thread was started, and how many runs ended with an exception.
+    std::uint64_t starts() const;
+    std::uint64_t failures() const;
 
 protected:
     virtual void run() = 0;
     virtual bool should_stop();
 
+    // Becomes readable when stop() is requested; run() loops poll it next to their data fds.
+    int wakeup_fd() const;
+
 protected:
     std::thread thread_;
     std::atomic<Status> status_{Status::Stopped};
+
+private:
+    Wakeup wakeup_;
+    std::atomic<std::uint64_t> starts_{0};
+    std::atomic<std::uint64_t> failures_{0};
 };
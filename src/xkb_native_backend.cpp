@@ -0,0 +1,202 @@
+#include "xkb_native_backend.h"
+
+#include <cstdlib>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+
+#include <X11/Xlib.h>
+
+namespace
+{
+
+// Symbols components that do not describe a layout, e.g. "pc" or "inet(evdev)".
+const std::set<std::string_view> g_non_layout_symbols = {
+    "altwin", "capslock", "compose", "ctrl", "eurosign", "group", "inet", "keypad", "kpdl",
+    "level3", "level5", "lv3", "nbsp", "pc", "rupeesign", "shift", "srvr_ctrl", "terminate"};
+
+std::string atom_name(Display * const display, const Atom atom)
+{
+    if (atom == None)
+    {
+        return {};
+    }
+
+    char * const name = XGetAtomName(display, atom);
+
+    if (name == nullptr)
+    {
+        return {};
+    }
+
+    std::string result{name};
+    XFree(name);
+    return result;
+}
+
+}
+
+XkbNativeBackend::XkbNativeBackend()
+    : display_{XOpenDisplay(NULL)}
+{
+    if (display_ == nullptr)
+    {
+        throw std::runtime_error("XOpenDisplay()");
+    }
+
+    if (!XkbQueryExtension(display_, nullptr, &xkb_event_type_, nullptr, nullptr, nullptr))
+    {
+        XCloseDisplay(display_);
+        throw std::runtime_error("XkbQueryExtension()");
+    }
+
+    const unsigned int events = XkbNewKeyboardNotifyMask | XkbNamesNotifyMask;
+    XkbSelectEvents(display_, XkbUseCoreKbd, events, events);
+    resolve_names();
+}
+
+XkbNativeBackend::~XkbNativeBackend()
+{
+    XCloseDisplay(display_);
+}
+
+std::string XkbNativeBackend::get_layout() const
+{
+    const std::scoped_lock lock{mutex_};
+    process_events();
+
+    XkbStateRec state;
+
+    if (XkbGetState(display_, XkbUseCoreKbd, &state) != Success)
+    {
+        return {};
+    }
+
+    return state.group < groups_.size() ? groups_[state.group].layout : std::string{};
+}
+
+void XkbNativeBackend::set_layout(const std::string & layout) const
+{
+    const std::scoped_lock lock{mutex_};
+    process_events();
+
+    const int group = find_group(layout);
+
+    if (group < 0)
+    {
+        return;
+    }
+
+    XkbLockGroup(display_, XkbUseCoreKbd, group);
+    XFlush(display_);
+}
+
+void XkbNativeBackend::process_events() const
+{
+    // Only keyboard and names notifications are selected, so the queue is normally empty and this
+    // does not wait for the server.
+    while (XPending(display_))
+    {
+        XEvent event;
+        XNextEvent(display_, &event);
+
+        if (event.type != xkb_event_type_)
+        {
+            continue;
+        }
+
+        const XkbEvent * const xkb_event = reinterpret_cast<const XkbEvent *>(&event);
+
+        if (xkb_event->any.xkb_type == XkbNewKeyboardNotify
+            || xkb_event->any.xkb_type == XkbNamesNotify)
+        {
+            names_changed_ = true;
+        }
+    }
+
+    if (names_changed_)
+    {
+        resolve_names();
+    }
+}
+
+void XkbNativeBackend::resolve_names() const
+{
+    names_changed_ = false;
+    groups_ = {};
+
+    XkbDescPtr const desc = XkbAllocKeyboard();
+
+    if (desc == nullptr)
+    {
+        throw std::runtime_error("XkbAllocKeyboard()");
+    }
+
+    desc->device_spec = XkbUseCoreKbd;
+
+    if (XkbGetNames(display_, XkbSymbolsNameMask | XkbGroupNamesMask, desc) == Success)
+    {
+        for (std::size_t i = 0; i < groups_.size(); ++i)
+        {
+            groups_[i].name = atom_name(display_, desc->names->groups[i]);
+        }
+
+        // The symbols name looks like "pc+us+ru(phonetic):2+inet(evdev)"; the ":N" suffix gives the
+        // 1-based group of a component and defaults to the first group.
+        const std::string symbols = atom_name(display_, desc->names->symbols);
+        std::size_t begin = 0;
+
+        while (begin < symbols.size())
+        {
+            std::size_t end = symbols.find('+', begin);
+            end = end == std::string::npos ? symbols.size() : end;
+
+            std::string_view component{symbols.data() + begin, end - begin};
+            begin = end + 1;
+
+            std::size_t group = 0;
+            const std::size_t colon = component.find(':');
+
+            if (colon != std::string_view::npos)
+            {
+                group = std::strtoul(std::string{component.substr(colon + 1)}.c_str(), nullptr, 10) - 1;
+                component = component.substr(0, colon);
+            }
+
+            const std::string_view base = component.substr(0, component.find('('));
+
+            if (group < groups_.size() && groups_[group].layout.empty()
+                && g_non_layout_symbols.count(base) == 0)
+            {
+                groups_[group].layout = component;
+            }
+        }
+    }
+
+    XkbFreeKeyboard(desc, 0, True);
+}
+
+int XkbNativeBackend::find_group(const std::string & layout) const
+{
+    for (std::size_t i = 0; i < groups_.size(); ++i)
+    {
+        if (!layout.empty() && groups_[i].layout == layout)
+        {
+            return i;
+        }
+    }
+
+    // Allow "us" to select "us(dvorak)" and full group names such as "English (US)".
+    for (std::size_t i = 0; i < groups_.size(); ++i)
+    {
+        const std::string & group_layout = groups_[i].layout;
+        const std::string_view base = std::string_view{group_layout}.substr(0, group_layout.find('('));
+
+        if (!layout.empty() && (base == layout || groups_[i].name == layout))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
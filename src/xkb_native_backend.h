@@ -0,0 +1,41 @@
+#pragma once
+
+#include "layout_backend.h"
+
+#include <array>
+#include <mutex>
+#include <string>
+
+#include <X11/XKBlib.h>
+
+// Switches layouts over a persistent X connection. Layout names are resolved to group indices once
+// and re-resolved only when the server reports a new keyboard or changed names, so switching costs
+// a single XkbLockGroup request.
+class XkbNativeBackend : public LayoutBackend
+{
+public:
+    XkbNativeBackend();
+    ~XkbNativeBackend() override;
+
+    std::string get_layout() const override;
+    void set_layout(const std::string & layout) const override;
+
+private:
+    struct Group
+    {
+        // Symbols name as reported by libxkbswitch, e.g. "us" or "us(dvorak)".
+        std::string layout;
+        std::string name;
+    };
+
+    void process_events() const;
+    void resolve_names() const;
+    int find_group(const std::string & layout) const;
+
+private:
+    mutable std::mutex mutex_;
+    Display * const display_;
+    int xkb_event_type_ = 0;
+    mutable bool names_changed_ = true;
+    mutable std::array<Group, XkbNumKbdGroups> groups_;
+};
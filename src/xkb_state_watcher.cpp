@@ -0,0 +1,76 @@
+#include "xkb_state_watcher.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#include <X11/XKBlib.h>
+
+XkbStateWatcher::XkbStateWatcher(OnGroupChanged on_group_changed)
+    : on_group_changed_{std::move(on_group_changed)}
+{
+    assert(on_group_changed_ != nullptr);
+}
+
+XkbStateWatcher::~XkbStateWatcher()
+{
+    close();
+}
+
+std::vector<int> XkbStateWatcher::open()
+{
+    Display * const display = XOpenDisplay(NULL);
+
+    if (display == nullptr)
+    {
+        throw std::runtime_error("XOpenDisplay()");
+    }
+
+    XkbQueryExtension(display, 0, &xkb_event_type_, 0, 0, 0);
+    XkbSelectEventDetails(display, XkbUseCoreKbd, XkbStateNotify, XkbGroupStateMask, XkbGroupStateMask);
+    XSync(display, False);
+
+    display_ = display;
+    return {ConnectionNumber(display_)};
+}
+
+void XkbStateWatcher::close()
+{
+    if (display_ != nullptr)
+    {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+    }
+}
+
+void XkbStateWatcher::on_readable(int)
+{
+    process_events();
+}
+
+int XkbStateWatcher::prepare()
+{
+    process_events();
+    return -1;
+}
+
+void XkbStateWatcher::process_events()
+{
+    while (XPending(display_))
+    {
+        XEvent event;
+        XNextEvent(display_, &event);
+
+        if (event.type != xkb_event_type_)
+        {
+            continue;
+        }
+
+        const XkbEvent * const xkb_event = reinterpret_cast<const XkbEvent *>(&event);
+
+        if (xkb_event->any.xkb_type == XkbStateNotify
+            && (xkb_event->state.changed & XkbGroupStateMask) != 0)
+        {
+            on_group_changed_(xkb_event->state.group);
+        }
+    }
+}
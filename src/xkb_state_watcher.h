@@ -0,0 +1,31 @@
+#pragma once
+
+#include "reactor.h"
+
+#include <functional>
+#include <vector>
+
+#include <X11/Xlib.h>
+
+using OnGroupChanged = std::function<void(int group)>;
+
+// Reports changes of the locked keyboard group on the local display; runs as a Reactor handler.
+class XkbStateWatcher : public EventHandler
+{
+public:
+    explicit XkbStateWatcher(OnGroupChanged on_group_changed);
+    ~XkbStateWatcher() override;
+
+    std::vector<int> open() override;
+    void close() override;
+    void on_readable(int fd) override;
+    int prepare() override;
+
+private:
+    void process_events();
+
+private:
+    const OnGroupChanged on_group_changed_;
+    Display * display_ = nullptr;
+    int xkb_event_type_ = 0;
+};
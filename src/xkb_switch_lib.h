@@ -1,17 +1,19 @@
 #pragma once
 
+#include "layout_backend.h"
+
 #include <filesystem>
 #include <string>
 #include <functional>
 
-class XkbSwitchLib
+class XkbSwitchLib : public LayoutBackend
 {
 public:
     explicit XkbSwitchLib(std::filesystem::path file_path);
-    ~XkbSwitchLib();
+    ~XkbSwitchLib() override;
 
-    std::string get_layout() const;
-    void set_layout(const std::string & layout) const;
+    std::string get_layout() const override;
+    void set_layout(const std::string & layout) const override;
 
 private:
     void * const module_handle_;